@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <prefr/prefr.h>
+#include <prefr/utils/SIMD.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace prefr;
+
+static const float deltaTime = 0.01f;
+
+void initParticles( Particles& particles )
+{
+  std::srand( 0 );
+
+  float invRandMax = 1.0f / RAND_MAX;
+
+  for( auto particle : particles )
+  {
+    particle.set_life( std::rand( ) * invRandMax * 2.0f );
+    particle.set_alive( std::rand( ) % 10 != 0 );
+    particle.set_position( glm::vec3( 0.0f ));
+    particle.set_velocity( glm::vec3( std::rand( ) * invRandMax,
+                                      std::rand( ) * invRandMax,
+                                      std::rand( ) * invRandMax ));
+    particle.set_velocityModule( std::rand( ) * invRandMax * 10.0f );
+  }
+}
+
+// Per-particle path through particle iterators, as done by
+// Updater::updateParticle.
+unsigned int iteratorStep( Particles& particles )
+{
+  unsigned int killed = 0;
+
+  for( auto particle : particles )
+  {
+    particle.set_life( particle.life( ) - deltaTime );
+
+    if( particle.alive( ))
+    {
+      if( particle.life( ) <= 0.0f )
+      {
+        particle.set_life( 0.0f );
+        particle.set_alive( false );
+        ++killed;
+      }
+
+      particle.set_position( particle.position( ) + particle.velocity( ) *
+                             particle.velocityModule( ) * deltaTime );
+    }
+  }
+
+  return killed;
+}
+
+// Vectorized path, as done by Updater::updateRange.
+unsigned int kernelStep( Particles& particles )
+{
+  ParticleSpan span = particles.span( 0, particles.numParticles( ));
+
+  float* life = span.attribute< attrib::Life >( );
+  char* alive = span.attribute< attrib::Alive >( );
+
+  simd::decreaseLife( life, span.length, deltaTime );
+
+  float* position[ 3 ];
+  const float* velocity[ 3 ];
+  for( unsigned int c = 0; c < 3; ++c )
+  {
+    position[ c ] = span.attribute< attrib::Position >( ).component( c );
+    velocity[ c ] = span.attribute< attrib::Velocity >( ).component( c );
+  }
+
+  simd::integrate( position, velocity,
+                   span.attribute< attrib::VelocityModule >( ), alive,
+                   span.length, deltaTime );
+
+  static std::vector< unsigned int > killed;
+  killed.resize( span.length );
+
+  return simd::expire( life, alive, killed.data( ), span.length );
+}
+
+template< typename Step >
+double run( Particles& particles, unsigned int iterations, Step step,
+            unsigned int& killed, double& checksum )
+{
+  initParticles( particles );
+
+  killed = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now( );
+
+  for( unsigned int i = 0; i < iterations; ++i )
+    killed += step( particles );
+
+  auto end = std::chrono::high_resolution_clock::now( );
+
+  checksum = 0;
+  for( auto particle : particles )
+    checksum += particle.position( ).x + particle.position( ).y +
+                particle.position( ).z + particle.life( );
+
+  return std::chrono::duration< double, std::milli >( end - begin ).count( ) /
+      iterations;
+}
+
+int main( int argc, char** argv )
+{
+  std::vector< unsigned int > sizes;
+  for( int i = 1; i < argc; ++i )
+    sizes.push_back( std::atoi( argv[ i ]));
+
+  if( sizes.empty( ))
+    sizes = { 1000000, 10000000 };
+
+  const unsigned int iterations = 20;
+
+  for( auto size : sizes )
+  {
+    Particles particles( size );
+
+    unsigned int killed;
+    double checksum;
+
+    double reference = run( particles, iterations, iteratorStep,
+                            killed, checksum );
+
+    std::cout << size << " particles" << std::endl;
+    std::cout << std::fixed << std::setprecision( 3 )
+              << "  Iterator\t" << reference << " ms\t1.00x"
+              << "\tkilled " << killed << "\tchecksum " << checksum
+              << std::endl;
+
+    simd::InstructionSet best = simd::instructionSet( );
+
+    for( auto instructionSet : { simd::Scalar, simd::SSE4,
+                                 simd::AVX2, simd::AVX512 })
+    {
+      if( !simd::instructionSet( instructionSet ))
+        continue;
+
+      double time = run( particles, iterations, kernelStep,
+                         killed, checksum );
+
+      std::cout << "  " << simd::name( instructionSet )
+                << "\t" << time << " ms\t" << std::setprecision( 2 )
+                << reference / time << "x" << std::setprecision( 3 )
+                << "\tkilled " << killed << "\tchecksum " << checksum
+                << std::endl;
+    }
+
+    simd::instructionSet( best );
+  }
+
+  return 0;
+}
@@ -0,0 +1,1385 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "GLComputeParticleSystem.h"
+
+#include "../core/Sampler.h"
+#include "../utils/Log.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace prefr
+{
+
+  /*! Invocations of each compute work group. */
+  static const unsigned int workGroupSize = 256;
+
+  /*! Keys sorted in shared memory by each work group of the local bitonic
+   * sort kernel, two per invocation. */
+  static const unsigned int sortBlock = 2 * workGroupSize;
+
+  /*! Layout of the curves and of the attributes buffer, shared with
+   * GLRenderer. */
+  static const unsigned int curveSamples = GLRenderConfig::curveSamples;
+  static const unsigned int attributePlanes = GLRenderConfig::attributePlanes;
+
+  /*! Reference word of particles that are not updated, and bit set in the
+   * words of particles to be killed before updating them. */
+  static const GLuint noReference = 0xFFFF;
+  static const GLuint resetBit = 0x80000000;
+  static const GLuint maxModels = 0x8000;
+
+  /*! Shader storage bindings of the kernels. */
+  static const GLuint attributesBinding = 0;
+  static const GLuint stateBinding = 1;
+  static const GLuint aliveBinding = 2;
+  static const GLuint referencesBinding = 3;
+  static const GLuint sourcesBinding = 4;
+  static const GLuint modelsBinding = 5;
+  static const GLuint curvesBinding = 6;
+  static const GLuint countersBinding = 7;
+  static const GLuint emittedBinding = 8;
+  static const GLuint keysBinding = 9;
+  static const GLuint commandBinding = 10;
+  static const GLuint idsBinding = 11;
+
+  /*! Source table entry, with the std430 layout of the kernels. */
+  struct SourceEntry
+  {
+    GLfloat position[ 4 ];
+    GLfloat radius;
+    GLfloat cosAngle;
+    GLuint budget;
+    GLuint limit;
+    GLuint enabled;
+    GLuint padding[ 3 ];
+  };
+
+  /*! Model table entry, with the std430 layout of the kernels. */
+  struct ModelEntry
+  {
+    GLfloat minLife;
+    GLfloat lifeRange;
+    GLfloat lifeNormalization;
+    GLfloat padding;
+  };
+
+  static const char* updateKernel = R"(
+    struct Source
+    {
+      vec4 position;
+      float radius;
+      float cosAngle;
+      uint budget;
+      uint limit;
+      uint enabled;
+      uint padding[ 3 ];
+    };
+
+    struct Model
+    {
+      float minLife;
+      float lifeRange;
+      float lifeNormalization;
+      float padding;
+    };
+
+    layout( std430, binding = 0 ) buffer Attributes { float attributes[ ]; };
+    layout( std430, binding = 1 ) buffer State { vec4 state[ ]; };
+    layout( std430, binding = 2 ) buffer Alive { uint alive[ ]; };
+    layout( std430, binding = 3 ) buffer References { uint references[ ]; };
+    layout( std430, binding = 4 ) readonly buffer Sources
+    {
+      Source sources[ ];
+    };
+    layout( std430, binding = 5 ) readonly buffer Models { Model models[ ]; };
+    layout( std430, binding = 6 ) readonly buffer Curves { vec4 curves[ ]; };
+    layout( std430, binding = 7 ) buffer Counters { uint counters[ ]; };
+    layout( std430, binding = 8 ) buffer Emitted { uint emitted[ ]; };
+
+    uniform uint particles;
+    uniform uint sourceCount;
+    uniform float deltaTime;
+    uniform uint frame;
+    uniform uint seed;
+
+    const uint noReference = 0xFFFFu;
+    const uint resetBit = 0x80000000u;
+    const uint lifeStream = 0u;
+    const uint sampleStream = 1u;
+
+    shared uint groupSource;
+    shared uint groupAlive;
+
+    // Philox4x32-10, as prefr::philox.
+    uvec4 philox( uvec4 counter, uvec2 key )
+    {
+      for( int round = 0; round < 10; ++round )
+      {
+        uint high0, low0, high1, low1;
+        umulExtended( 0xD2511F53u, counter.x, high0, low0 );
+        umulExtended( 0xCD9E8D57u, counter.z, high1, low1 );
+
+        counter = uvec4( high1 ^ counter.y ^ key.x, low1,
+                         high0 ^ counter.w ^ key.y, low0 );
+        key += uvec2( 0x9E3779B9u, 0xBB67AE85u );
+      }
+
+      return counter;
+    }
+
+    float unitFloat( uint value )
+    {
+      return float( value >> 8 ) * ( 1.0 / 16777216.0 );
+    }
+
+    // Polynomial sine and cosine of prefr::simd::coneDirections, evaluated
+    // without fused operations so results match the CPU ones.
+    vec3 coneDirection( float u, float v, float cosAngle )
+    {
+      precise float y = 1.0 - u * ( 1.0 - cosAngle );
+      precise float radius = sqrt( max( 1.0 - y * y, 0.0 ));
+
+      // Angle around the axis as a quadrant plus an offset in
+      // [ -pi/4, pi/4 ].
+      precise float turns = v * 4.0;
+      precise float quadrant = floor( turns + 0.5 );
+      precise float x = ( turns - quadrant ) * 1.57079632679;
+      precise float x2 = x * x;
+
+      precise float sine = (( 1.0 / 362880.0 * x2 - 1.0 / 5040.0 ) * x2 +
+                            1.0 / 120.0 ) * x2 - 1.0 / 6.0;
+      sine = ( x * x2 ) * sine + x;
+      precise float cosine = (( 1.0 / 40320.0 * x2 - 1.0 / 720.0 ) * x2 +
+                              1.0 / 24.0 ) * x2 - 1.0 / 2.0;
+      cosine = x2 * cosine + 1.0;
+
+      uint q = uint( quadrant ) & 3u;
+      if(( q & 1u ) != 0u )
+      {
+        float swapped = sine;
+        sine = cosine;
+        cosine = swapped;
+      }
+      if(( q & 2u ) != 0u )
+        sine = -sine;
+      if((( q + 1u ) & 2u ) != 0u )
+        cosine = -cosine;
+
+      return vec3( cosine * radius, y, sine * radius );
+    }
+
+    vec4 curve( uint row, float time )
+    {
+      float position = clamp( time, 0.0, 1.0 ) * float( CURVE_SAMPLES - 1u );
+      uint i = min( uint( position ), CURVE_SAMPLES - 2u );
+
+      return mix( curves[ row + i ], curves[ row + i + 1u ],
+                  position - float( i ));
+    }
+
+    bool emit( uint source, Source emitter )
+    {
+      // Attempts are checked before counting them, so that sources without
+      // budget left take no atomic operation.
+      if( counters[ source ] >= emitter.budget ||
+          atomicAdd( counters[ source ], 1u ) >= emitter.budget )
+        return false;
+
+      // Emission cycles bound the total of emitted particles.
+      if( atomicAdd( emitted[ source ], 1u ) >= emitter.limit )
+      {
+        atomicAdd( emitted[ source ], 0xFFFFFFFFu );
+        return false;
+      }
+
+      return true;
+    }
+
+    bool updateParticle( uint id, uint source, uint model )
+    {
+      Source emitter = sources[ source ];
+      Model parameters = models[ model ];
+
+      vec4 particle = state[ id ];
+      bool living = alive[ id ] != 0u;
+      vec3 position;
+
+      particle.w -= deltaTime;
+
+      if( living )
+      {
+        position = vec3( attributes[ id ], attributes[ particles + id ],
+                         attributes[ 2u * particles + id ]);
+      }
+      else if( emit( source, emitter ))
+      {
+        uvec2 key = uvec2( id, seed );
+
+        uvec4 words = philox( uvec4( frame, lifeStream, 0u, 0u ), key );
+        particle.w = unitFloat( words.x ) * parameters.lifeRange +
+                     parameters.minLife;
+
+        words = philox( uvec4( frame, sampleStream, 0u, 0u ), key );
+        particle.xyz = coneDirection( unitFloat( words.x ),
+                                      unitFloat( words.y ),
+                                      emitter.cosAngle );
+
+        position = emitter.position.xyz + particle.xyz * emitter.radius;
+        living = true;
+      }
+
+      if( living )
+      {
+        float time = 1.0 - clamp( particle.w * parameters.lifeNormalization,
+                                  0.0, 1.0 );
+
+        // Color row, followed by size and velocity module.
+        uint row = 2u * model * CURVE_SAMPLES;
+        vec4 color = curve( row, time );
+        vec4 sizeVelocity = curve( row + CURVE_SAMPLES, time );
+
+        position += particle.xyz * sizeVelocity.y * deltaTime;
+
+        attributes[ id ] = position.x;
+        attributes[ particles + id ] = position.y;
+        attributes[ 2u * particles + id ] = position.z;
+        attributes[ 3u * particles + id ] = sizeVelocity.x;
+        attributes[ 4u * particles + id ] = color.r;
+        attributes[ 5u * particles + id ] = color.g;
+        attributes[ 6u * particles + id ] = color.b;
+        attributes[ 7u * particles + id ] = color.a;
+
+        if( particle.w <= 0.0 )
+        {
+          particle.w = 0.0;
+          living = false;
+        }
+      }
+
+      state[ id ] = particle;
+      alive[ id ] = living ? 1u : 0u;
+
+      return living;
+    }
+
+    void main( )
+    {
+      uint id = gl_GlobalInvocationID.x;
+      uint reference = id < particles ? references[ id ] : noReference;
+      uint source = reference & noReference;
+      bool updated = source != noReference && sources[ source ].enabled != 0u;
+
+      if( gl_LocalInvocationIndex == 0u )
+      {
+        groupSource = updated ? source : noReference;
+        groupAlive = 0u;
+      }
+
+      // Particles moved to another source, or not updated any more, are
+      // killed as the CPU simulation does.
+      if(( reference & resetBit ) != 0u )
+      {
+        references[ id ] = reference & ~resetBit;
+        alive[ id ] = 0u;
+        state[ id ].w = 0.0;
+      }
+
+      bool living = false;
+      if( updated )
+        living = updateParticle( id, source, ( reference >> 16 ) & 0x7FFFu );
+
+      barrier( );
+
+      // Neighbour particles usually share their source, so most of them are
+      // counted in shared memory.
+      if( living )
+      {
+        if( source == groupSource )
+          atomicAdd( groupAlive, 1u );
+        else
+          atomicAdd( counters[ sourceCount + source ], 1u );
+      }
+
+      barrier( );
+
+      if( gl_LocalInvocationIndex == 0u && groupAlive > 0u )
+        atomicAdd( counters[ sourceCount + groupSource ], groupAlive );
+    }
+  )";
+
+  static const char* keysKernel = R"(
+    layout( std430, binding = 0 ) readonly buffer Attributes
+    {
+      float attributes[ ];
+    };
+    layout( std430, binding = 2 ) readonly buffer Alive { uint alive[ ]; };
+    layout( std430, binding = 9 ) writeonly buffer Keys { uvec2 keys[ ]; };
+    layout( std430, binding = 10 ) buffer Command { uint command[ ]; };
+
+    uniform uint particles;
+    uniform vec3 camera;
+    uniform vec3 axis;
+    uniform bool depth;
+
+    shared uint groupAlive;
+
+    void main( )
+    {
+      uint id = gl_GlobalInvocationID.x;
+
+      if( gl_LocalInvocationIndex == 0u )
+        groupAlive = 0u;
+
+      barrier( );
+
+      // Float bits are flipped so that their unsigned order is the float
+      // order. Zero is below any of them, so dead particles are sorted last.
+      uint key = 0u;
+      if( id < particles && alive[ id ] != 0u )
+      {
+        vec3 offset = vec3( attributes[ id ], attributes[ particles + id ],
+                            attributes[ 2u * particles + id ]) - camera;
+
+        uint bits = floatBitsToUint( depth ? dot( offset, axis ) :
+                                             dot( offset, offset ));
+
+        key = ( bits & 0x80000000u ) != 0u ? ~bits : bits | 0x80000000u;
+
+        atomicAdd( groupAlive, 1u );
+      }
+
+      keys[ id ] = uvec2( key, id );
+
+      barrier( );
+
+      // Instance count of the indirect draw.
+      if( gl_LocalInvocationIndex == 0u && groupAlive > 0u )
+        atomicAdd( command[ 1 ], groupAlive );
+    }
+  )";
+
+  static const char* sortKernel = R"(
+    layout( std430, binding = 9 ) buffer Keys { uvec2 keys[ ]; };
+
+    uniform uint sequence;
+    uniform uint distance;
+
+    // Compares the keys distance apart within bitonic sequences of the
+    // given size, sorting them in descending order.
+    void main( )
+    {
+      uint pair = gl_GlobalInvocationID.x;
+      uint i = 2u * distance * ( pair / distance ) + pair % distance;
+      uint j = i + distance;
+
+      uvec2 first = keys[ i ];
+      uvec2 second = keys[ j ];
+
+      bool descending = ( i & sequence ) == 0u;
+      if( descending ? first.x < second.x : first.x > second.x )
+      {
+        keys[ i ] = second;
+        keys[ j ] = first;
+      }
+    }
+  )";
+
+  static const char* sortLocalKernel = R"(
+    layout( std430, binding = 9 ) buffer Keys { uvec2 keys[ ]; };
+
+    // Size of the sequences to merge, or 0 to sort whole blocks.
+    uniform uint sequence;
+
+    shared uvec2 block[ SORT_BLOCK ];
+
+    // Runs the steps of the bitonic sort comparing keys inside a block.
+    void main( )
+    {
+      uint local = gl_LocalInvocationIndex;
+      uint upper = local + WORK_GROUP_SIZE;
+      uint offset = gl_WorkGroupID.x * SORT_BLOCK;
+
+      block[ local ] = keys[ offset + local ];
+      block[ upper ] = keys[ offset + upper ];
+
+      barrier( );
+
+      uint first = sequence == 0u ? 2u : sequence;
+      uint last = sequence == 0u ? SORT_BLOCK : sequence;
+
+      for( uint size = first; size <= last; size <<= 1 )
+      {
+        for( uint distance = min( size, SORT_BLOCK ) >> 1; distance > 0u;
+             distance >>= 1 )
+        {
+          uint i = 2u * distance * ( local / distance ) + local % distance;
+          uint j = i + distance;
+
+          uvec2 firstKey = block[ i ];
+          uvec2 secondKey = block[ j ];
+
+          bool descending = (( offset + i ) & size ) == 0u;
+          if( descending ? firstKey.x < secondKey.x :
+                           firstKey.x > secondKey.x )
+          {
+            block[ i ] = secondKey;
+            block[ j ] = firstKey;
+          }
+
+          barrier( );
+        }
+      }
+
+      keys[ offset + local ] = block[ local ];
+      keys[ offset + upper ] = block[ upper ];
+    }
+  )";
+
+  static const char* idsKernel = R"(
+    layout( std430, binding = 9 ) readonly buffer Keys { uvec2 keys[ ]; };
+    layout( std430, binding = 11 ) writeonly buffer Ids { uint ids[ ]; };
+
+    uniform uint particles;
+
+    void main( )
+    {
+      uint id = gl_GlobalInvocationID.x;
+
+      if( id < particles )
+        ids[ id ] = keys[ id ].y;
+    }
+  )";
+
+  static GLuint workGroups( unsigned int invocations )
+  {
+    return ( invocations + workGroupSize - 1 ) / workGroupSize;
+  }
+
+  static GLuint compileKernel( const char* name, const char* body )
+  {
+    std::string source = "#version 430\n"
+        "#define WORK_GROUP_SIZE " + std::to_string( workGroupSize ) + "u\n"
+        "#define SORT_BLOCK " + std::to_string( sortBlock ) + "u\n"
+        "#define CURVE_SAMPLES " + std::to_string( curveSamples ) + "u\n"
+        "layout( local_size_x = WORK_GROUP_SIZE ) in;\n";
+    source += body;
+
+    const char* sourceText = source.c_str( );
+
+    GLuint shader = glCreateShader( GL_COMPUTE_SHADER );
+    glShaderSource( shader, 1, &sourceText, nullptr );
+    glCompileShader( shader );
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+
+    if( !compiled )
+    {
+      GLchar info[ 1024 ] = { 0 };
+      glGetShaderInfoLog( shader, sizeof( info ), nullptr, info );
+
+      Log::log( std::string( "Compute kernel " ) + name +
+                " could not be compiled: " + info, LOG_LEVEL_ERROR );
+
+      glDeleteShader( shader );
+      return 0;
+    }
+
+    GLuint program = glCreateProgram( );
+    glAttachShader( program, shader );
+    glLinkProgram( program );
+    glDeleteShader( shader );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv( program, GL_LINK_STATUS, &linked );
+
+    if( !linked )
+    {
+      Log::log( std::string( "Compute kernel " ) + name +
+                " could not be linked.", LOG_LEVEL_ERROR );
+
+      glDeleteProgram( program );
+      return 0;
+    }
+
+    return program;
+  }
+
+  static void storageBuffer( GLuint buffer, GLsizeiptr size,
+                             const void* data = nullptr,
+                             GLenum usage = GL_DYNAMIC_DRAW )
+  {
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffer );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, size, data, usage );
+  }
+
+  static void clearBuffer( GLuint buffer )
+  {
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffer );
+    glClearBufferData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+                       GL_UNSIGNED_INT, nullptr );
+  }
+
+  GLComputeParticleSystem::GLComputeParticleSystem( unsigned int maxParticles,
+                                                    ICamera* camera )
+  : ParticleSystem( maxParticles, camera )
+  , _glRenderer( nullptr )
+  , _updateProgram( 0 )
+  , _keysProgram( 0 )
+  , _sortProgram( 0 )
+  , _sortLocalProgram( 0 )
+  , _idsProgram( 0 )
+  , _stateBuffer( 0 )
+  , _aliveBuffer( 0 )
+  , _referencesBuffer( 0 )
+  , _sourcesBuffer( 0 )
+  , _modelsBuffer( 0 )
+  , _curvesBuffer( 0 )
+  , _countersBuffer( 0 )
+  , _emittedBuffer( 0 )
+  , _keysBuffer( 0 )
+  , _indirectBuffer( 0 )
+  , _readbackBuffer( 0 )
+  , _readbackFence( 0 )
+  , _sortSize( 0 )
+  , _referencesSupported( false )
+  , _computeAvailable( false )
+  , _device( false )
+  , _cameraPosition( 0.0f )
+  { }
+
+  GLComputeParticleSystem::~GLComputeParticleSystem( )
+  {
+    _destroyBuffers( );
+    _destroyKernels( );
+  }
+
+  void GLComputeParticleSystem::renderer( Renderer* renderer_ )
+  {
+    // Particles are brought back from the previous renderer buffers before
+    // releasing the resources created for it.
+    if( _device )
+      _useDevice( false );
+
+    _destroyBuffers( );
+    _destroyKernels( );
+
+    _glRenderer = dynamic_cast< GLRenderer* >( renderer_ );
+
+    // Kernels write straight into the attributes and instance buffers.
+    if( _glRenderer )
+    {
+      _glRenderer->persistentMapping( false );
+      _glRenderer->instanceFormat( GLRenderer::INDEXED_INSTANCES );
+    }
+
+    ParticleSystem::renderer( renderer_ );
+
+    _computeAvailable = _glRenderer &&
+        _glRenderer->_glRenderConfig->_indexedInstances && _createKernels( );
+
+    if( !_computeAvailable )
+    {
+      Log::log( "Compute shaders not available, simulating on the CPU.",
+                LOG_LEVEL_WARNING );
+      return;
+    }
+
+    _createBuffers( );
+
+    _updateConfig._referencesChanged = true;
+  }
+
+  bool GLComputeParticleSystem::_createKernels( void )
+  {
+    if( !GLEW_VERSION_4_3 )
+      return false;
+
+    unsigned int particles = _particles.numParticles( );
+
+    _sortSize = sortBlock;
+    while( _sortSize < particles )
+      _sortSize <<= 1;
+
+    GLint64 maxBlockSize = 0;
+    glGetInteger64v( GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize );
+
+    GLint64 attributesSize =
+        GLint64( particles ) * attributePlanes * sizeof( GLfloat );
+    GLint64 keysSize = GLint64( _sortSize ) * 2 * sizeof( GLuint );
+
+    if( std::max( attributesSize, keysSize ) > maxBlockSize )
+    {
+      Log::log( "Shader storage blocks too small for the particles.",
+                LOG_LEVEL_WARNING );
+      return false;
+    }
+
+    _updateProgram = compileKernel( "update", updateKernel );
+    _keysProgram = compileKernel( "keys", keysKernel );
+    _sortProgram = compileKernel( "sort", sortKernel );
+    _sortLocalProgram = compileKernel( "local sort", sortLocalKernel );
+    _idsProgram = compileKernel( "ids", idsKernel );
+
+    if( _updateProgram && _keysProgram && _sortProgram &&
+        _sortLocalProgram && _idsProgram )
+      return true;
+
+    _destroyKernels( );
+
+    return false;
+  }
+
+  void GLComputeParticleSystem::_destroyKernels( void )
+  {
+    GLuint* programs[ ] = { &_updateProgram, &_keysProgram, &_sortProgram,
+                            &_sortLocalProgram, &_idsProgram };
+
+    for( GLuint* program : programs )
+    {
+      if( *program )
+        glDeleteProgram( *program );
+
+      *program = 0;
+    }
+  }
+
+  void GLComputeParticleSystem::_createBuffers( void )
+  {
+    GLuint* buffers[ ] = { &_stateBuffer, &_aliveBuffer, &_referencesBuffer,
+                           &_sourcesBuffer, &_modelsBuffer, &_curvesBuffer,
+                           &_countersBuffer, &_emittedBuffer, &_keysBuffer,
+                           &_indirectBuffer, &_readbackBuffer };
+
+    for( GLuint* buffer : buffers )
+      glGenBuffers( 1, buffer );
+
+    GLsizeiptr particles = _particles.numParticles( );
+
+    storageBuffer( _stateBuffer, particles * 4 * sizeof( GLfloat ));
+    storageBuffer( _aliveBuffer, particles * sizeof( GLuint ));
+    storageBuffer( _referencesBuffer, particles * sizeof( GLuint ));
+    storageBuffer( _keysBuffer, _sortSize * 2 * sizeof( GLuint ));
+
+    // Vertices of the billboard, instance count, first vertex and first
+    // instance.
+    GLuint command[ 4 ] = { 4, 0, 0, 0 };
+    storageBuffer( _indirectBuffer, sizeof( command ), command );
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    _tableSources.clear( );
+    _tableModels.clear( );
+    _curvesBaked.clear( );
+    _references.clear( );
+  }
+
+  void GLComputeParticleSystem::_destroyBuffers( void )
+  {
+    if( _readbackFence )
+      glDeleteSync( _readbackFence );
+
+    _readbackFence = 0;
+
+    GLuint* buffers[ ] = { &_stateBuffer, &_aliveBuffer, &_referencesBuffer,
+                           &_sourcesBuffer, &_modelsBuffer, &_curvesBuffer,
+                           &_countersBuffer, &_emittedBuffer, &_keysBuffer,
+                           &_indirectBuffer, &_readbackBuffer };
+
+    for( GLuint* buffer : buffers )
+    {
+      if( *buffer )
+        glDeleteBuffers( 1, buffer );
+
+      *buffer = 0;
+    }
+  }
+
+  bool GLComputeParticleSystem::computeAvailable( void ) const
+  {
+    return _computeAvailable;
+  }
+
+  bool GLComputeParticleSystem::computeActive( void ) const
+  {
+    return _device;
+  }
+
+  bool GLComputeParticleSystem::_supported( void ) const
+  {
+    if( !_referencesSupported )
+      return false;
+
+    // Samplers can be replaced at any time, so they are checked each frame.
+    for( auto source : _tableSources )
+    {
+      const Sampler* sampler = source->sampler( );
+
+      if( !sampler || ( typeid( *sampler ) != typeid( PointSampler ) &&
+                        typeid( *sampler ) != typeid( SphereSampler )))
+        return false;
+    }
+
+    return true;
+  }
+
+  void GLComputeParticleSystem::_buildReferences( void )
+  {
+    std::vector< Model* > models( _models.begin( ), _models.end( ));
+
+    // Emission counters are indexed by source, so they restart along with
+    // the sources table.
+    if( _sourcesVec != _tableSources )
+    {
+      _tableSources = _sourcesVec;
+      _sourcesEmitted.assign( _tableSources.size( ), 0 );
+
+      if( _readbackFence )
+        glDeleteSync( _readbackFence );
+
+      _readbackFence = 0;
+
+      GLsizeiptr counters = std::max< size_t >( _tableSources.size( ), 1 );
+
+      storageBuffer( _countersBuffer, 2 * counters * sizeof( GLuint ));
+      storageBuffer( _emittedBuffer, counters * sizeof( GLuint ));
+      clearBuffer( _emittedBuffer );
+
+      glBindBuffer( GL_COPY_WRITE_BUFFER, _readbackBuffer );
+      glBufferData( GL_COPY_WRITE_BUFFER, 2 * counters * sizeof( GLuint ),
+                    nullptr, GL_STREAM_READ );
+      glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+    }
+
+    _tableModels = models;
+
+    std::unordered_map< Source*, GLuint > sourceIndices;
+    for( unsigned int i = 0; i < _tableSources.size( ); ++i )
+      sourceIndices[ _tableSources[ i ]] = i;
+
+    std::unordered_map< Model*, GLuint > modelIndices;
+    for( unsigned int i = 0; i < _tableModels.size( ); ++i )
+      modelIndices[ _tableModels[ i ]] = i;
+
+    _referencesSupported = _tableSources.size( ) < noReference &&
+                           _tableModels.size( ) <= maxModels;
+
+    unsigned int particles = _particles.numParticles( );
+    std::vector< GLuint > references( particles, noReference );
+
+    for( unsigned int i = 0; i < particles && _referencesSupported; ++i )
+    {
+      Source* source = _referenceSources[ i ];
+      Model* model = _referenceModels[ i ];
+      Updater* updater = _referenceUpdaters[ i ];
+
+      if( !source || !model || !updater )
+        continue;
+
+      auto sourceIndex = sourceIndices.find( source );
+      auto modelIndex = modelIndices.find( model );
+
+      // Updaters not batched and elements unknown to the system can only be
+      // simulated on the CPU.
+      _referencesSupported = updater->_batched( ) &&
+                             sourceIndex != sourceIndices.end( ) &&
+                             modelIndex != modelIndices.end( );
+
+      if( _referencesSupported )
+        references[ i ] = sourceIndex->second | modelIndex->second << 16;
+    }
+
+    _updateConfig._referencesChanged = false;
+
+    if( _device && _referencesSupported )
+    {
+      // Particles moved to another source, or not updated any more, are
+      // killed by the next update.
+      std::vector< GLuint > words( references );
+      for( unsigned int i = 0; i < particles; ++i )
+      {
+        bool stopped = ( words[ i ] & noReference ) == noReference &&
+                       ( _references[ i ] & noReference ) != noReference;
+
+        if( _referenceSources[ i ] != _deviceSources[ i ] || stopped )
+          words[ i ] |= resetBit;
+      }
+
+      glBindBuffer( GL_SHADER_STORAGE_BUFFER, _referencesBuffer );
+      glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                       particles * sizeof( GLuint ), words.data( ));
+      glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+      _deviceSources = _referenceSources;
+    }
+
+    _references.swap( references );
+  }
+
+  void GLComputeParticleSystem::_uploadParticles( void )
+  {
+    GLsizeiptr particles = _particles.numParticles( );
+
+    auto& velocities = _particles.attribute< attrib::Velocity >( );
+    auto& lives = _particles.attribute< attrib::Life >( );
+    auto& alive = _particles.attribute< attrib::Alive >( );
+
+    GLfloat* planes[ attributePlanes ];
+    GLRenderConfig::attributeArrays( _particles, planes );
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER,
+                  _glRenderer->_glRenderConfig->_vboParticlesAttributes );
+
+    for( unsigned int p = 0; p < attributePlanes; ++p )
+      glBufferSubData( GL_SHADER_STORAGE_BUFFER,
+                       p * particles * sizeof( GLfloat ),
+                       particles * sizeof( GLfloat ), planes[ p ]);
+
+    std::vector< glm::vec4 > state( particles );
+    std::vector< GLuint > flags( particles );
+
+    for( GLsizeiptr i = 0; i < particles; ++i )
+    {
+      state[ i ] = glm::vec4( velocities.component( 0 )[ i ],
+                              velocities.component( 1 )[ i ],
+                              velocities.component( 2 )[ i ], lives[ i ]);
+      flags[ i ] = alive[ i ] ? 1 : 0;
+    }
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, _stateBuffer );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                     particles * sizeof( glm::vec4 ), state.data( ));
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, _aliveBuffer );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                     particles * sizeof( GLuint ), flags.data( ));
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, _referencesBuffer );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                     particles * sizeof( GLuint ), _references.data( ));
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    _deviceSources = _referenceSources;
+  }
+
+  void GLComputeParticleSystem::downloadParticles( void )
+  {
+    if( !_device )
+      return;
+
+    GLsizeiptr particles = _particles.numParticles( );
+
+    std::vector< GLfloat > attributes( particles * attributePlanes );
+    std::vector< glm::vec4 > state( particles );
+    std::vector< GLuint > flags( particles );
+
+    glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER,
+                  _glRenderer->_glRenderConfig->_vboParticlesAttributes );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                        attributes.size( ) * sizeof( GLfloat ),
+                        attributes.data( ));
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, _stateBuffer );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                        particles * sizeof( glm::vec4 ), state.data( ));
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, _aliveBuffer );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0,
+                        particles * sizeof( GLuint ), flags.data( ));
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    auto& velocities = _particles.attribute< attrib::Velocity >( );
+    auto& lives = _particles.attribute< attrib::Life >( );
+    auto& alive = _particles.attribute< attrib::Alive >( );
+
+    GLfloat* planes[ attributePlanes ];
+    GLRenderConfig::attributeArrays( _particles, planes );
+
+    for( unsigned int p = 0; p < attributePlanes; ++p )
+      std::copy( attributes.begin( ) + p * particles,
+                 attributes.begin( ) + ( p + 1 ) * particles, planes[ p ]);
+
+    for( GLsizeiptr i = 0; i < particles; ++i )
+    {
+      for( unsigned int c = 0; c < 3; ++c )
+        velocities.component( c )[ i ] = state[ i ][ c ];
+
+      lives[ i ] = state[ i ].w;
+      alive[ i ] = flags[ i ] != 0;
+    }
+  }
+
+  void GLComputeParticleSystem::_useDevice( bool device )
+  {
+    GLRenderConfig* config = _glRenderer->_glRenderConfig;
+
+    if( device )
+    {
+      _uploadParticles( );
+    }
+    else
+    {
+      // Sources take over from the particles left by the GPU.
+      downloadParticles( );
+
+      auto& alive = _particles.attribute< attrib::Alive >( );
+
+      for( unsigned int i = 0; i < _particles.numParticles( ); ++i )
+      {
+        if( !_referenceSources[ i ])
+          continue;
+
+        _flagsDead.set( i, !alive[ i ]);
+        _flagsEmitted.set( i, false );
+      }
+
+      for( auto source : _sourcesVec )
+      {
+        source->_rebuildFreeIndices( );
+        source->_rebuildAliveIndices( );
+      }
+
+      config->_attributesValid = false;
+      _sorter->_particlesChanged = true;
+    }
+
+    if( _readbackFence )
+      glDeleteSync( _readbackFence );
+
+    _readbackFence = 0;
+
+    config->_deviceInstances = device;
+    config->_indirectBuffer = device ? _indirectBuffer : 0;
+
+    _device = device;
+  }
+
+  void GLComputeParticleSystem::prepareFrame( float deltaTime )
+  {
+    _sourcesVec = _sources.vector( );
+
+    if( _computeAvailable &&
+        ( _updateConfig._referencesChanged || _sourcesVec != _tableSources ||
+          _models.size( ) != _tableModels.size( )))
+      _buildReferences( );
+
+    bool device = _computeAvailable && _supported( );
+    if( device != _device )
+      _useDevice( device );
+
+    if( !_device )
+    {
+      ParticleSystem::prepareFrame( deltaTime );
+      return;
+    }
+
+    _aliveParticles = 0;
+
+    _updateConfig._random.nextFrame( );
+
+    for( auto model : _models )
+      model->bake( );
+
+    _sorter->sources( &_sourcesVec );
+
+    // Particles are emitted by the update kernel, so sources only compute
+    // their budget, with no free particles to emit on the CPU.
+    for( auto source : _sourcesVec )
+    {
+      if( source->particles( ).empty( ) || !source->active( ))
+        continue;
+
+      source->_freeIndicesSize = 0;
+      source->_freeIndicesSorted = 0;
+      source->prepareFrame( deltaTime );
+    }
+  }
+
+  void GLComputeParticleSystem::_uploadTables( void )
+  {
+    std::vector< SourceEntry > sources( std::max< size_t >(
+        _tableSources.size( ), 1 ));
+
+    for( unsigned int s = 0; s < _tableSources.size( ); ++s )
+    {
+      Source* source = _tableSources[ s ];
+      SourceEntry& entry = sources[ s ];
+
+      glm::vec3 position = source->position( );
+      for( unsigned int c = 0; c < 3; ++c )
+        entry.position[ c ] = position[ c ];
+
+      entry.radius = 0.0f;
+      entry.cosAngle = -1.0f;
+
+      auto sphere = dynamic_cast< const SphereSampler* >( source->sampler( ));
+      if( sphere )
+      {
+        entry.radius = sphere->radius( );
+        entry.cosAngle = sphere->cosAngle( );
+      }
+
+      unsigned int size = source->particles( ).size( );
+
+      entry.budget = 0;
+      if( source->continuing( ))
+        entry.budget = source->_emissionRate <= 0.0f ?
+            size : std::max( source->_particlesBudget, 0 );
+
+      // Total of emitted particles allowed by the remaining cycles.
+      entry.limit = std::numeric_limits< GLuint >::max( );
+      if( source->_maxEmissionCycles > 0 )
+      {
+        int64_t remaining = int64_t( source->_maxEmissionCycles -
+                                     source->_currentCycle ) * size -
+                            source->_emittedParticles;
+
+        entry.limit = GLuint( std::min< int64_t >(
+            _sourcesEmitted[ s ] + std::max< int64_t >( remaining, 0 ),
+            entry.limit ));
+      }
+
+      entry.enabled = source->active( ) && size > 0;
+    }
+
+    std::vector< ModelEntry > models( std::max< size_t >(
+        _tableModels.size( ), 1 ));
+
+    for( unsigned int m = 0; m < _tableModels.size( ); ++m )
+    {
+      Model* model = _tableModels[ m ];
+
+      models[ m ].minLife = model->_minLife;
+      models[ m ].lifeRange = model->_lifeRange;
+      models[ m ].lifeNormalization = model->_lifeNormalization;
+    }
+
+    storageBuffer( _sourcesBuffer, sources.size( ) * sizeof( SourceEntry ),
+                   sources.data( ), GL_STREAM_DRAW );
+    storageBuffer( _modelsBuffer, models.size( ) * sizeof( ModelEntry ),
+                   models.data( ), GL_STREAM_DRAW );
+
+    // Curves are baked per model in two rows of samples: color, and size
+    // and velocity module. They are sampled again only when the models or
+    // their curves change.
+    if( GLRenderConfig::curvesChanged( _tableModels, _curvesBaked ))
+    {
+      std::vector< glm::vec4 > curves( 2 * curveSamples * models.size( ),
+                                       glm::vec4( 0.0f ));
+
+      for( unsigned int m = 0; m < _tableModels.size( ); ++m )
+      {
+        Model* model = _tableModels[ m ];
+
+        glm::vec4* colors = &curves[ 2 * m * curveSamples ];
+        glm::vec4* values = colors + curveSamples;
+
+        for( unsigned int j = 0; j < curveSamples; ++j )
+        {
+          float time = float( j ) / ( curveSamples - 1 );
+
+          colors[ j ] = model->color.GetLookupValue( time );
+          values[ j ].x = model->size.GetLookupValue( time );
+          values[ j ].y = model->velocity.GetLookupValue( time );
+        }
+      }
+
+      storageBuffer( _curvesBuffer, curves.size( ) * sizeof( glm::vec4 ),
+                     curves.data( ), GL_STATIC_DRAW );
+    }
+
+    clearBuffer( _countersBuffer );
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+  }
+
+  void GLComputeParticleSystem::updateFrame( float deltaTime )
+  {
+    if( !_device )
+    {
+      ParticleSystem::updateFrame( deltaTime );
+      return;
+    }
+
+    _uploadTables( );
+
+    GLuint attributes = _glRenderer->_glRenderConfig->_vboParticlesAttributes;
+
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, attributesBinding,
+                      attributes );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, stateBinding, _stateBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, aliveBinding, _aliveBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, referencesBinding,
+                      _referencesBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, sourcesBinding,
+                      _sourcesBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, modelsBinding, _modelsBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, curvesBinding, _curvesBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, countersBinding,
+                      _countersBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, emittedBinding,
+                      _emittedBuffer );
+
+    glUseProgram( _updateProgram );
+
+    glUniform1ui( glGetUniformLocation( _updateProgram, "particles" ),
+                  _particles.numParticles( ));
+    glUniform1ui( glGetUniformLocation( _updateProgram, "sourceCount" ),
+                  _tableSources.size( ));
+    glUniform1f( glGetUniformLocation( _updateProgram, "deltaTime" ),
+                 deltaTime );
+    glUniform1ui( glGetUniformLocation( _updateProgram, "frame" ),
+                  _updateConfig._random.frame( ));
+    glUniform1ui( glGetUniformLocation( _updateProgram, "seed" ),
+                  _updateConfig._random.seed( ));
+
+    glDispatchCompute( workGroups( _particles.numParticles( )), 1, 1 );
+
+    // Attributes are read by the renderer through a buffer texture, and
+    // counters copied for the readback.
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT |
+                     GL_TEXTURE_FETCH_BARRIER_BIT |
+                     GL_BUFFER_UPDATE_BARRIER_BIT );
+
+    glUseProgram( 0 );
+  }
+
+  void GLComputeParticleSystem::_readCounters( void )
+  {
+    unsigned int sources = _tableSources.size( );
+
+    if( _readbackFence )
+    {
+      // Counters are applied once the GPU is done, without waiting for it.
+      GLenum status = glClientWaitSync( _readbackFence, 0, 0 );
+
+      if( status == GL_TIMEOUT_EXPIRED )
+        return;
+
+      glDeleteSync( _readbackFence );
+      _readbackFence = 0;
+
+      if( status == GL_WAIT_FAILED )
+        return;
+
+      std::vector< GLuint > counters( 2 * sources );
+
+      glBindBuffer( GL_COPY_READ_BUFFER, _readbackBuffer );
+      glGetBufferSubData( GL_COPY_READ_BUFFER, 0,
+                          counters.size( ) * sizeof( GLuint ),
+                          counters.data( ));
+      glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+
+      for( unsigned int s = 0; s < sources; ++s )
+      {
+        Source* source = _tableSources[ s ];
+        GLuint emitted = counters[ sources + s ];
+
+        source->_emittedParticles += emitted - _sourcesEmitted[ s ];
+        source->_aliveParticles = counters[ s ];
+
+        _sourcesEmitted[ s ] = emitted;
+      }
+    }
+
+    if( sources == 0 )
+      return;
+
+    // Alive particles of each source, followed by the emitted ones.
+    GLsizeiptr size = sources * sizeof( GLuint );
+
+    glBindBuffer( GL_COPY_WRITE_BUFFER, _readbackBuffer );
+
+    glBindBuffer( GL_COPY_READ_BUFFER, _countersBuffer );
+    glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                         size, 0, size );
+
+    glBindBuffer( GL_COPY_READ_BUFFER, _emittedBuffer );
+    glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                         0, size, size );
+
+    glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+    glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+    _readbackFence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+  }
+
+  void GLComputeParticleSystem::finishFrame( void )
+  {
+    if( !_device )
+    {
+      ParticleSystem::finishFrame( );
+      return;
+    }
+
+    _readCounters( );
+
+    unsigned int aliveParticles = 0;
+
+    for( auto source : _sourcesVec )
+    {
+      if( source->particles( ).empty( ) || !source->active( ))
+        continue;
+
+      source->closeFrame( );
+
+      aliveParticles += source->aliveParticles( );
+    }
+
+    _aliveParticles += aliveParticles;
+
+    _sorter->_aliveParticles = _aliveParticles;
+    _glRenderer->_glRenderConfig->_aliveParticles = _aliveParticles;
+  }
+
+  void GLComputeParticleSystem::updateCameraDistances(
+      const glm::vec3& cameraPosition )
+  {
+    if( !_device )
+      ParticleSystem::updateCameraDistances( cameraPosition );
+    else if( _run )
+      _cameraPosition = cameraPosition;
+  }
+
+  void GLComputeParticleSystem::updateCameraDistances( void )
+  {
+    if( !_device )
+      ParticleSystem::updateCameraDistances( );
+    else if( _run && _camera )
+      _cameraPosition = _camera->PReFrCameraPosition( );
+  }
+
+  void GLComputeParticleSystem::updateRender( void )
+  {
+    if( !_device )
+    {
+      ParticleSystem::updateRender( );
+      return;
+    }
+
+    if( _run )
+    {
+      _sortParticles( );
+      _renderer->setupRender( );
+    }
+  }
+
+  void GLComputeParticleSystem::_sortParticles( void )
+  {
+    GLRenderConfig* config = _glRenderer->_glRenderConfig;
+    GLuint particles = _particles.numParticles( );
+
+    // The keys kernel counts the instances to draw.
+    GLuint zero = 0;
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, _indirectBuffer );
+    glClearBufferSubData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, sizeof( GLuint ),
+                          sizeof( GLuint ), GL_RED_INTEGER, GL_UNSIGNED_INT,
+                          &zero );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, attributesBinding,
+                      config->_vboParticlesAttributes );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, aliveBinding, _aliveBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, keysBinding, _keysBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, commandBinding,
+                      _indirectBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, idsBinding,
+                      config->_vboParticlesPositions );
+
+    // Depth along the view direction, as Sorter::distanceKey.
+    bool depth = _sorter->distanceKey( ) == Sorter::Depth && _camera;
+    glm::vec3 axis( 0.0f );
+
+    if( depth )
+    {
+      glm::mat4x4 view = _camera->PReFrCameraViewMatrix( );
+      axis = glm::vec3( -view[ 0 ][ 2 ], -view[ 1 ][ 2 ], -view[ 2 ][ 2 ]);
+    }
+
+    glUseProgram( _keysProgram );
+
+    glUniform1ui( glGetUniformLocation( _keysProgram, "particles" ),
+                  particles );
+    glUniform3fv( glGetUniformLocation( _keysProgram, "camera" ), 1,
+                  glm::value_ptr( _cameraPosition ));
+    glUniform3fv( glGetUniformLocation( _keysProgram, "axis" ), 1,
+                  glm::value_ptr( axis ));
+    glUniform1i( glGetUniformLocation( _keysProgram, "depth" ), depth );
+
+    glDispatchCompute( _sortSize / workGroupSize, 1, 1 );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+
+    // Bitonic sort. Steps comparing keys closer than a block are run in
+    // shared memory by a single dispatch.
+    GLint localSequence =
+        glGetUniformLocation( _sortLocalProgram, "sequence" );
+    GLint sequence = glGetUniformLocation( _sortProgram, "sequence" );
+    GLint distance = glGetUniformLocation( _sortProgram, "distance" );
+
+    GLuint blocks = _sortSize / sortBlock;
+
+    glUseProgram( _sortLocalProgram );
+    glUniform1ui( localSequence, 0 );
+    glDispatchCompute( blocks, 1, 1 );
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+
+    for( GLuint size = 2 * sortBlock; size <= _sortSize; size <<= 1 )
+    {
+      glUseProgram( _sortProgram );
+      glUniform1ui( sequence, size );
+
+      for( GLuint step = size >> 1; step >= sortBlock; step >>= 1 )
+      {
+        glUniform1ui( distance, step );
+        glDispatchCompute( _sortSize / 2 / workGroupSize, 1, 1 );
+        glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+      }
+
+      glUseProgram( _sortLocalProgram );
+      glUniform1ui( localSequence, size );
+      glDispatchCompute( blocks, 1, 1 );
+      glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+    }
+
+    glUseProgram( _idsProgram );
+    glUniform1ui( glGetUniformLocation( _idsProgram, "particles" ),
+                  particles );
+    glDispatchCompute( workGroups( particles ), 1, 1 );
+
+    // Ids are read as instance attributes, and the instance count by the
+    // indirect draw.
+    glMemoryBarrier( GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                     GL_COMMAND_BARRIER_BIT );
+
+    glUseProgram( 0 );
+  }
+
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __PREFR__GL_COMPUTE_PARTICLE_SYSTEM__
+#define __PREFR__GL_COMPUTE_PARTICLE_SYSTEM__
+
+#include <prefr/api.h>
+
+#include "../core/ParticleSystem.h"
+#include "GLRenderer.h"
+
+#include <vector>
+
+namespace prefr
+{
+
+  /*! \class GLComputeParticleSystem
+   *
+   * \brief Particle system simulated by OpenGL compute shaders.
+   *
+   * Keeps the state of every particle in shader storage buffers and runs
+   * emission, life, curve evaluation and integration as compute dispatches,
+   * so particle data never goes through the CPU. Sources, models and their
+   * curves are uploaded as tables each frame. Sort keys, the bitonic sort of
+   * particles and the instance ids are computed on the GPU too, and drawn
+   * through an indirect command holding the number of alive particles.
+   *
+   * Requires OpenGL 4.3 and a GLRenderer, which is switched to
+   * INDEXED_INSTANCES: the kernels write position, size and color straight
+   * into its attributes buffer, and the sorted ids into its instance
+   * buffer. Particles are simulated on the CPU, as by ParticleSystem, when
+   * compute shaders are not available, or while any particle uses an
+   * Updater that is not batched or a sampler other than PointSampler and
+   * SphereSampler.
+   *
+   * Differences with the CPU simulation:
+   *   - Random numbers and the emission direction polynomial match the CPU
+   *     ones, but free particles are emitted in no particular order.
+   *     Values differ from the CPU ones in the last bits, as GPU square
+   *     roots and curve interpolation are not rounded the same way.
+   *   - Alive particles and emission counters of sources are read back
+   *     without stalling, so they lag a couple of frames. The number of
+   *     emitted particles still respects the emission cycles of sources.
+   *   - Particles are sorted as Sorter does with the Descending order and
+   *     its distance key, but neither incremental sorting nor the rendering
+   *     of dead particles are supported.
+   *   - Particle data in CPU memory are only updated by downloadParticles.
+   *
+   * The instance format of the renderer must not be changed afterwards.
+   *
+   * @see ParticleSystem
+   * @see GLRenderer::instanceFormat
+   */
+  class GLComputeParticleSystem : public ParticleSystem
+  {
+
+  public:
+
+    PREFR_API
+    GLComputeParticleSystem( unsigned int maxParticles,
+                             ICamera* camera = nullptr );
+
+    PREFR_API
+    virtual ~GLComputeParticleSystem( );
+
+    using ParticleSystem::renderer;
+
+    /*! \brief Sets the Renderer object, which must be a GLRenderer.
+     *
+     * Switches the renderer to INDEXED_INSTANCES, without persistent
+     * mapping, and creates the compute kernels and buffers. Requires a
+     * current OpenGL context. If compute shaders are not available, a
+     * warning is logged and the system runs on the CPU.
+     *
+     * @param renderer GLRenderer object to be assigned.
+     */
+    PREFR_API
+    virtual void renderer( Renderer* renderer );
+
+    PREFR_API
+    virtual void updateCameraDistances( const glm::vec3& cameraPosition );
+
+    PREFR_API
+    virtual void updateCameraDistances( void );
+
+    PREFR_API
+    virtual void updateRender( void );
+
+    /*! \brief Returns true if the kernels could be created, so particles
+     * are simulated on the GPU when every source, model and updater is
+     * supported. */
+    PREFR_API
+    bool computeAvailable( void ) const;
+
+    /*! \brief Returns true if particles were simulated on the GPU on the
+     * last update. */
+    PREFR_API
+    bool computeActive( void ) const;
+
+    /*! \brief Copies the state of every particle from the GPU into the
+     * particles of the system.
+     *
+     * Waits for the GPU to finish the pending dispatches, so it is meant
+     * for inspecting particles, not for being called every frame. Nothing
+     * is done while simulating on the CPU.
+     */
+    PREFR_API
+    void downloadParticles( void );
+
+  protected:
+
+    virtual void prepareFrame( float deltaTime );
+    virtual void updateFrame( float deltaTime );
+    virtual void finishFrame( void );
+
+    bool _createKernels( void );
+    void _destroyKernels( void );
+    void _createBuffers( void );
+    void _destroyBuffers( void );
+
+    bool _supported( void ) const;
+    void _buildReferences( void );
+    void _uploadParticles( void );
+    void _uploadTables( void );
+    void _readCounters( void );
+    void _useDevice( bool device );
+    void _sortParticles( void );
+
+    GLRenderer* _glRenderer;
+
+    /*! Compute programs: update, sort keys, global and local bitonic sort
+     * steps, and instance ids. */
+    GLuint _updateProgram;
+    GLuint _keysProgram;
+    GLuint _sortProgram;
+    GLuint _sortLocalProgram;
+    GLuint _idsProgram;
+
+    /*! Velocity and life, and alive flag of each particle. */
+    GLuint _stateBuffer;
+    GLuint _aliveBuffer;
+
+    /*! Source and model indices of each particle. */
+    GLuint _referencesBuffer;
+
+    GLuint _sourcesBuffer;
+    GLuint _modelsBuffer;
+    GLuint _curvesBuffer;
+
+    /*! Emission attempts and alive particles of each source this frame,
+     * and particles emitted by each source since the tables were built. */
+    GLuint _countersBuffer;
+    GLuint _emittedBuffer;
+
+    GLuint _keysBuffer;
+    GLuint _indirectBuffer;
+
+    /*! Copy of the counters read once its fence is signaled. */
+    GLuint _readbackBuffer;
+    GLsync _readbackFence;
+
+    /*! Number of keys sorted, the next power of two of the particles. */
+    unsigned int _sortSize;
+
+    /*! Sources and models in the order of the uploaded tables. */
+    std::vector< Source* > _tableSources;
+    std::vector< Model* > _tableModels;
+
+    /*! Curves of the table models uploaded to the curves buffer. */
+    GLRenderConfig::BakedCurves _curvesBaked;
+
+    /*! Emitted particles of each source already added to its count. */
+    std::vector< unsigned int > _sourcesEmitted;
+
+    /*! Reference words of each particle, and the source they were built
+     * from, to detect particles moved to another source. */
+    std::vector< unsigned int > _references;
+    std::vector< Source* > _deviceSources;
+
+    bool _referencesSupported;
+    bool _computeAvailable;
+    bool _device;
+
+    glm::vec3 _cameraPosition;
+  };
+
+}
+
+#endif /* __PREFR__GL_COMPUTE_PARTICLE_SYSTEM__ */
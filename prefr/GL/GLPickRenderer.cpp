@@ -203,14 +203,14 @@ namespace prefr
                    viewMatrix[ 1 ][ 0 ],
                    viewMatrix[ 2 ][ 0 ]);
 
+      _bindTextures( _glPickProgram );
     }
     else
       std::cout << "Render error: Shader " << _glPickProgram
                 << " or camera" << _glRenderConfig->_camera
                 << " is null." << std::endl;
 
-    glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4,
-                           _glRenderConfig->_aliveParticles );
+    _drawInstances( );
 
     glBindVertexArray( 0 );
 
@@ -27,9 +27,14 @@
 #include <GL/glew.h>
 #endif
 
+#include <algorithm>
+#include <utility>
 #include <vector>
 
+#include "../core/Model.h"
+#include "../core/Particles.h"
 #include "../core/RenderConfig.h"
+#include "../utils/InterpolationSet.hpp"
 #include "IGLRenderProgram.h"
 
 namespace prefr
@@ -38,27 +43,110 @@ namespace prefr
   {
     friend class GLRenderer;
     friend class GLPickRenderer;
+    friend class GLComputeParticleSystem;
 
   public:
 
+    /*! Number of frames whose instance data can be in flight when buffers
+     * are persistently mapped. */
+    static const unsigned int ringSegments = 3;
+
+    /*! Planes of the attributes buffer of indexed instances, read by the
+     * GLindexed shaders and written by GLComputeParticleSystem. */
+    static const unsigned int attributePlanes = 8;
+
+    /*! Samples of each curve baked for the GPU. Samples are entries of the
+     * default InterpolationSet lookup table, so linear filtering reproduces
+     * InterpolationSet::GetLookupValue. */
+    static const unsigned int curveSamples =
+        ::utils::InterpolationSet< float >::defaultLookupTableSize + 1;
+
+    /*! \brief Returns the particle arrays of each attribute plane: position,
+     * size and color components.
+     */
+    static void attributeArrays( Particles& particles,
+                                 GLfloat* planes[ attributePlanes ])
+    {
+      auto& positions = particles.attribute< attrib::Position >( );
+      auto& sizes = particles.attribute< attrib::Size >( );
+      auto& colors = particles.attribute< attrib::Color >( );
+
+      GLfloat* arrays[ attributePlanes ] =
+      {
+        positions.component( 0 ), positions.component( 1 ),
+        positions.component( 2 ), sizes.data( ),
+        colors.component( 0 ), colors.component( 1 ),
+        colors.component( 2 ), colors.component( 3 )
+      };
+
+      std::copy( arrays, arrays + attributePlanes, planes );
+    }
+
+    /*! Models whose curves were last baked for the GPU, along with the
+     * number of lookup table rebuilds of their curves at that time. */
+    typedef std::vector< std::pair< const Model*, unsigned int >> BakedCurves;
+
+    /*! \brief Records models in baked and returns true if the model set or
+     * any of their curves changed since baked was last recorded. Curves
+     * changed but not baked yet always count as changed.
+     */
+    template< class Models >
+    static bool curvesChanged( const Models& models, BakedCurves& baked )
+    {
+      bool changed = baked.size( ) != models.size( );
+      baked.resize( models.size( ));
+
+      unsigned int i = 0;
+      for( const Model* model : models )
+      {
+        unsigned int bakes = model->color.bakes + model->size.bakes +
+                             model->velocity.bakes;
+
+        if( model->color.dirty || model->size.dirty ||
+            model->velocity.dirty || baked[ i ].first != model ||
+            baked[ i ].second != bakes )
+        {
+          baked[ i ] = std::make_pair( model, bakes );
+          changed = true;
+        }
+
+        ++i;
+      }
+
+      return changed;
+    }
+
     GLRenderConfig( unsigned int size )
     : RenderConfig( size )
     , _billboardVertices( new std::vector< GLfloat >( size ) )
-    , _particlePositions( new std::vector< GLfloat >( size ) )
-    , _particleColors( new std::vector< GLfloat >( size ))
     , _vao( 0 )
     , _boBillboardVertex( 0 )
     , _vboParticlesPositions( 0 )
     , _vboParticlesColors( 0 )
+    , _interleavedInstances( false )
+    , _curveInstances( false )
+    , _indexedInstances( false )
+    , _persistentMapping( false )
+    , _ringSegment( 0 )
+    , _mappedPositions( nullptr )
+    , _mappedColors( nullptr )
+    , _curvesTexture( 0 )
+    , _curvesRows( 0 )
+    , _vboParticlesAttributes( 0 )
+    , _attributesTexture( 0 )
+    , _attributesValid( false )
+    , _deviceInstances( false )
+    , _indirectBuffer( 0 )
     , _camera( nullptr )
     , _glRenderProgram( nullptr )
-    {}
+    {
+      for( unsigned int i = 0; i < ringSegments; ++i )
+        _fences[ i ] = 0;
+    }
 
     virtual ~GLRenderConfig( )
     {
       delete( _billboardVertices );
-      delete( _particlePositions );
-      delete( _particleColors );
       _vao = 0;
       _boBillboardVertex = 0;
       _vboParticlesPositions = 0;
@@ -69,8 +157,6 @@ namespace prefr
 
     // Triangles vertices
     std::vector< GLfloat >* _billboardVertices;
-    std::vector< GLfloat >* _particlePositions;
-    std::vector< GLfloat >* _particleColors;
 
     // OpenGL pointers
     GLuint _vao;
@@ -78,6 +164,40 @@ namespace prefr
     GLuint _vboParticlesPositions;
     GLuint _vboParticlesColors;
 
+    // Instance buffers. When persistently mapped, each buffer holds
+    // ringSegments copies of the instance data, and the fence of each
+    // segment guards the draws still reading it. Otherwise buffers are
+    // orphaned and mapped on each upload. Compact and curve instances are
+    // interleaved in the positions buffer, and no colors buffer is created.
+    bool _interleavedInstances;
+    bool _curveInstances;
+    bool _indexedInstances;
+    bool _persistentMapping;
+    unsigned int _ringSegment;
+    GLubyte* _mappedPositions;
+    GLubyte* _mappedColors;
+    GLsync _fences[ ringSegments ];
+
+    // Color and size curves of every model, sampled into two texture rows
+    // per model, and the curves they were sampled from. Only created for
+    // curve instances.
+    GLuint _curvesTexture;
+    GLsizei _curvesRows;
+    BakedCurves _curvesBaked;
+
+    // Position, size and color of every particle in storage order, as one
+    // plane per component read through a buffer texture. Only created for
+    // indexed instances, whose instance data are the sorted particle ids.
+    GLuint _vboParticlesAttributes;
+    GLuint _attributesTexture;
+    bool _attributesValid;
+
+    // Set when instance data are written on the GPU, by
+    // GLComputeParticleSystem, so setupRender uploads nothing. Draws then
+    // take their instance count from the indirect buffer if not 0.
+    bool _deviceInstances;
+    GLuint _indirectBuffer;
+
     ICamera* _camera;
     IGLRenderProgram* _glRenderProgram;
   };
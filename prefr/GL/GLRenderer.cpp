@@ -25,21 +25,47 @@
 #include <iostream>
 
 #include "../utils/Log.h"
+#include "../utils/SIMD.h"
+
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 namespace prefr
 {
 
+  /*! Maximum number of particles gathered on each batch of compact
+   * instances. */
+  static const unsigned int packBatch = 256;
+
+  /*! Nanoseconds waited on each call to glClientWaitSync. */
+  static const GLuint64 fenceTimeout = 1000000;
+
+  /*! Bytes of each curve instance: float position, half float normalized
+   * life and unsigned short model index. */
+  static const unsigned int curveInstanceSize = 16;
+
+  /*! Layout of the curves texture and of the attributes buffer, shared
+   * with GLComputeParticleSystem. */
+  static const GLsizei curveSamples = GLRenderConfig::curveSamples;
+  static const unsigned int attributePlanes = GLRenderConfig::attributePlanes;
+
   GLRenderer::GLRenderer(  )
   : Renderer( )
   , _glRenderConfig( nullptr )
   , _glRenderProgram( nullptr )
+  , _persistentMapping( true )
+  , _instanceFormat( FLOAT_INSTANCES )
+  , _activeFormat( FLOAT_INSTANCES )
   {
     alphaBlendingFunc( ONE_MINUS_SRC_ALPHA );
   }
 
   GLRenderer::~GLRenderer( )
-  { }
+  {
+    if( _glRenderConfig )
+      _destroyInstanceBuffers( );
+  }
 
   void GLRenderer::_init( void )
   {
@@ -52,10 +78,6 @@ namespace prefr
                     -0.5f, 0.5f, 0.0f, 0.5f, 0.5f, 0.0f };
 
     _glRenderConfig->_billboardVertices = new std::vector< GLfloat >( 12 );
-    _glRenderConfig->_particlePositions =
-        new std::vector< GLfloat >( _particles.size( ) * 4 );
-    _glRenderConfig->_particleColors =
-        new std::vector< GLfloat >( _particles.size( ) * 4 );
 
     for ( unsigned int i = 0;
           i < _glRenderConfig->_billboardVertices->size( );
@@ -67,12 +89,7 @@ namespace prefr
     glGenVertexArrays( 1, &_glRenderConfig->_vao );
     glBindVertexArray( _glRenderConfig->_vao );
 
-    GLuint buffersGL[ 3 ];
-    glGenBuffers( 3, buffersGL );
-
-    _glRenderConfig->_boBillboardVertex = buffersGL[ 0 ];
-    _glRenderConfig->_vboParticlesPositions = buffersGL[ 1 ];
-    _glRenderConfig->_vboParticlesColors = buffersGL[ 2 ];
+    glGenBuffers( 1, &_glRenderConfig->_boBillboardVertex );
 
     // Assign billboard vertices
     glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_boBillboardVertex );
@@ -82,38 +99,356 @@ namespace prefr
                   &_glRenderConfig->_billboardVertices->front( ),
                   GL_STATIC_DRAW );
 
-
-    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesPositions );
-    glBufferData( GL_ARRAY_BUFFER,
-                  sizeof( GLfloat ) *
-                  _glRenderConfig->_particlePositions->size( ),
-                  nullptr,
-                  GL_DYNAMIC_DRAW );
-
-
-    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesColors );
-    glBufferData( GL_ARRAY_BUFFER,
-                  sizeof( GLfloat ) *
-                  _glRenderConfig->_particleColors->size( ),
-                  nullptr,
-                  GL_DYNAMIC_DRAW );
-
     // Bind vertices
     glEnableVertexAttribArray( 0 );
     glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_boBillboardVertex );
     glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, ( void* ) 0 );
 
+    glVertexAttribDivisor( 0, 0 );
+
+    _createInstanceBuffers( );
+  }
+
+  void GLRenderer::_createInstanceBuffers( void )
+  {
+    _activeFormat = _availableFormat( );
+
+    if( _activeFormat != _instanceFormat )
+    {
+      if( _programSupports( _instanceFormat ))
+        Log::log( "Texture buffers too small for indexed instances, "
+                  "using float instances.", LOG_LEVEL_WARNING );
+      else
+        Log::log( "Render program does not name the texture of the "
+                  "instance format, using float instances.",
+                  LOG_LEVEL_WARNING );
+    }
+
+    // Compact and curve instances interleave every attribute in the
+    // positions buffer, and indexed instances only store ids.
+    bool interleaved = _activeFormat != FLOAT_INSTANCES;
+    GLsizei bufferCount = interleaved ? 1 : 2;
+
+    GLuint buffersGL[ 2 ] = { 0, 0 };
+    glGenBuffers( bufferCount, buffersGL );
+
+    _glRenderConfig->_interleavedInstances = interleaved;
+    _glRenderConfig->_curveInstances = _activeFormat == CURVE_INSTANCES;
+    _glRenderConfig->_indexedInstances = _activeFormat == INDEXED_INSTANCES;
+
+    // Updaters skip curves only while the drawn instances evaluate them.
+    _evaluatesCurves = _glRenderConfig->_curveInstances;
+
+    GLsizeiptr segmentSize = _particles.size( ) * _instanceSize( );
+
+    bool persistent = _persistentMapping &&
+        ( GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage );
+
+    GLubyte* mapped[ 2 ] = { nullptr, nullptr };
+
+    if( persistent )
+    {
+      GLbitfield flags =
+          GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      GLsizeiptr size = segmentSize * GLRenderConfig::ringSegments;
+
+      for( GLsizei i = 0; i < bufferCount; ++i )
+      {
+        glBindBuffer( GL_ARRAY_BUFFER, buffersGL[ i ]);
+        glBufferStorage( GL_ARRAY_BUFFER, size, nullptr, flags );
+        mapped[ i ] = static_cast< GLubyte* >(
+            glMapBufferRange( GL_ARRAY_BUFFER, 0, size, flags ));
+
+        persistent = persistent && mapped[ i ];
+      }
+
+      if( !persistent )
+      {
+        Log::log( "Persistent mapping failed, orphaning instance buffers.",
+                  LOG_LEVEL_WARNING );
+
+        // Buffer storage is immutable, so new buffers are needed.
+        glDeleteBuffers( bufferCount, buffersGL );
+        glGenBuffers( bufferCount, buffersGL );
+
+        mapped[ 0 ] = mapped[ 1 ] = nullptr;
+      }
+    }
+
+    if( !persistent )
+    {
+      for( GLsizei i = 0; i < bufferCount; ++i )
+      {
+        glBindBuffer( GL_ARRAY_BUFFER, buffersGL[ i ]);
+        glBufferData( GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW );
+      }
+    }
+
+    _glRenderConfig->_vboParticlesPositions = buffersGL[ 0 ];
+    _glRenderConfig->_vboParticlesColors = buffersGL[ 1 ];
+    _glRenderConfig->_mappedPositions = mapped[ 0 ];
+    _glRenderConfig->_mappedColors = mapped[ 1 ];
+    _glRenderConfig->_persistentMapping = persistent;
+    _glRenderConfig->_ringSegment = 0;
+
+    if( _glRenderConfig->_curveInstances )
+    {
+      glGenTextures( 1, &_glRenderConfig->_curvesTexture );
+      glBindTexture( GL_TEXTURE_2D, _glRenderConfig->_curvesTexture );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+      glBindTexture( GL_TEXTURE_2D, 0 );
+
+      _glRenderConfig->_curvesRows = 0;
+      _glRenderConfig->_curvesBaked.clear( );
+    }
+
+    if( _glRenderConfig->_indexedInstances )
+    {
+      GLuint& attributes = _glRenderConfig->_vboParticlesAttributes;
+
+      glGenBuffers( 1, &attributes );
+      glBindBuffer( GL_TEXTURE_BUFFER, attributes );
+      glBufferData( GL_TEXTURE_BUFFER,
+                    _particles.size( ) * attributePlanes * sizeof( GLfloat ),
+                    nullptr, GL_DYNAMIC_DRAW );
+      glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+
+      glGenTextures( 1, &_glRenderConfig->_attributesTexture );
+      glBindTexture( GL_TEXTURE_BUFFER, _glRenderConfig->_attributesTexture );
+      glTexBuffer( GL_TEXTURE_BUFFER, GL_R32F, attributes );
+      glBindTexture( GL_TEXTURE_BUFFER, 0 );
+
+      _glRenderConfig->_attributesValid = false;
+    }
+
+    _tracksChanges = _glRenderConfig->_indexedInstances;
+    _changedSpans.clear( );
+
+    glBindVertexArray( _glRenderConfig->_vao );
+
     glEnableVertexAttribArray( 1 );
+
+    glVertexAttribDivisor( 1, 1 );
+    glVertexAttribDivisor( 2, 1 );
+
+    if( _glRenderConfig->_indexedInstances )
+      glDisableVertexAttribArray( 2 );
+    else
+      glEnableVertexAttribArray( 2 );
+
+    if( _glRenderConfig->_curveInstances )
+    {
+      glEnableVertexAttribArray( 3 );
+      glVertexAttribDivisor( 3, 1 );
+    }
+    else
+      glDisableVertexAttribArray( 3 );
+
+    _instanceAttributes( 0 );
+  }
+
+  void GLRenderer::_destroyInstanceBuffers( void )
+  {
+    for( unsigned int i = 0; i < GLRenderConfig::ringSegments; ++i )
+    {
+      if( _glRenderConfig->_fences[ i ])
+        glDeleteSync( _glRenderConfig->_fences[ i ]);
+
+      _glRenderConfig->_fences[ i ] = 0;
+    }
+
+    GLuint buffersGL[ 2 ] = { _glRenderConfig->_vboParticlesPositions,
+                              _glRenderConfig->_vboParticlesColors };
+    GLsizei bufferCount = _glRenderConfig->_interleavedInstances ? 1 : 2;
+
+    if( _glRenderConfig->_persistentMapping )
+    {
+      for( GLsizei i = 0; i < bufferCount; ++i )
+      {
+        glBindBuffer( GL_ARRAY_BUFFER, buffersGL[ i ]);
+        glUnmapBuffer( GL_ARRAY_BUFFER );
+      }
+    }
+
+    glDeleteBuffers( bufferCount, buffersGL );
+
+    if( _glRenderConfig->_curvesTexture )
+      glDeleteTextures( 1, &_glRenderConfig->_curvesTexture );
+
+    _glRenderConfig->_curvesTexture = 0;
+    _glRenderConfig->_curvesRows = 0;
+    _glRenderConfig->_curvesBaked.clear( );
+
+    if( _glRenderConfig->_attributesTexture )
+      glDeleteTextures( 1, &_glRenderConfig->_attributesTexture );
+
+    if( _glRenderConfig->_vboParticlesAttributes )
+      glDeleteBuffers( 1, &_glRenderConfig->_vboParticlesAttributes );
+
+    _glRenderConfig->_attributesTexture = 0;
+    _glRenderConfig->_vboParticlesAttributes = 0;
+    _glRenderConfig->_attributesValid = false;
+    _tracksChanges = false;
+    _evaluatesCurves = false;
+    _glRenderConfig->_vboParticlesPositions = 0;
+    _glRenderConfig->_vboParticlesColors = 0;
+    _glRenderConfig->_mappedPositions = nullptr;
+    _glRenderConfig->_mappedColors = nullptr;
+    _glRenderConfig->_persistentMapping = false;
+  }
+
+  GLsizeiptr GLRenderer::_instanceSize( void ) const
+  {
+    if( _glRenderConfig->_curveInstances )
+      return curveInstanceSize;
+
+    if( _glRenderConfig->_indexedInstances )
+      return sizeof( GLuint );
+
+    return _glRenderConfig->_interleavedInstances ?
+        simd::packedInstanceSize : sizeof( GLfloat ) * 4;
+  }
+
+  void GLRenderer::_instanceAttributes( GLintptr offset )
+  {
     glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesPositions );
-    glVertexAttribPointer( 1, 4, GL_FLOAT, GL_FALSE, 0, ( void* ) 0 );
 
-    glEnableVertexAttribArray( 2 );
+    if( _glRenderConfig->_indexedInstances )
+    {
+      glVertexAttribIPointer( 1, 1, GL_UNSIGNED_INT, 0, ( void* ) offset );
+      return;
+    }
+
+    if( _glRenderConfig->_curveInstances )
+    {
+      // Float position, half float life and the integer model index, which
+      // the shader uses to sample the curves texture.
+      GLsizei stride = curveInstanceSize;
+
+      glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, stride,
+                             ( void* ) offset );
+      glVertexAttribPointer( 2, 1, GL_HALF_FLOAT, GL_FALSE, stride,
+                             ( void* )( offset + 3 * sizeof( GLfloat )));
+      glVertexAttribIPointer( 3, 1, GL_UNSIGNED_SHORT, stride,
+                              ( void* )( offset + 3 * sizeof( GLfloat ) +
+                                         sizeof( GLhalf )));
+      return;
+    }
+
+    if( _glRenderConfig->_interleavedInstances )
+    {
+      // Half float position and size, followed by the RGBA8 color. Vertex
+      // fetch converts both to floats, so shaders are shared by formats.
+      GLsizei stride = simd::packedInstanceSize;
+
+      glVertexAttribPointer( 1, 4, GL_HALF_FLOAT, GL_FALSE, stride,
+                             ( void* ) offset );
+      glVertexAttribPointer( 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                             ( void* )( offset + 4 * sizeof( GLhalf )));
+      return;
+    }
+
+    glVertexAttribPointer( 1, 4, GL_FLOAT, GL_FALSE, 0, ( void* ) offset );
+
     glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesColors );
-    glVertexAttribPointer( 2, 4, GL_FLOAT, GL_TRUE, 0, ( void * ) 0 );
+    glVertexAttribPointer( 2, 4, GL_FLOAT, GL_TRUE, 0, ( void* ) offset );
+  }
 
-    glVertexAttribDivisor( 0, 0 );
-    glVertexAttribDivisor( 1, 1 );
-    glVertexAttribDivisor( 2, 1 );
+  bool GLRenderer::_mapInstanceBuffers( GLubyte*& positions, GLubyte*& colors )
+  {
+    GLsizeiptr segmentSize = _instanceSize( ) * _particles.size( );
+
+    if( _glRenderConfig->_persistentMapping )
+    {
+      // Fence the draws issued since the last upload, which read the current
+      // segment, and move to the oldest one once the GPU is done with it.
+      GLsync& previous =
+          _glRenderConfig->_fences[ _glRenderConfig->_ringSegment ];
+
+      if( previous )
+        glDeleteSync( previous );
+
+      previous = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+      _glRenderConfig->_ringSegment =
+          ( _glRenderConfig->_ringSegment + 1 ) % GLRenderConfig::ringSegments;
+
+      GLsync& fence = _glRenderConfig->_fences[ _glRenderConfig->_ringSegment ];
+
+      if( fence )
+      {
+        GLenum result = GL_TIMEOUT_EXPIRED;
+        while( result == GL_TIMEOUT_EXPIRED )
+          result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     fenceTimeout );
+
+        glDeleteSync( fence );
+        fence = 0;
+      }
+
+      GLsizeiptr offset = _glRenderConfig->_ringSegment * segmentSize;
+
+      positions = _glRenderConfig->_mappedPositions + offset;
+      colors = _glRenderConfig->_interleavedInstances ?
+          nullptr : _glRenderConfig->_mappedColors + offset;
+
+      return true;
+    }
+
+    // Orphaning gives new storage to the buffers while previous draws still
+    // read the old one, so mapping does not need to synchronize.
+    GLsizeiptr size = _instanceSize( ) * _glRenderConfig->_aliveParticles;
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                        GL_MAP_UNSYNCHRONIZED_BIT;
+
+    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesPositions );
+    glBufferData( GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW );
+    positions = static_cast< GLubyte* >(
+        glMapBufferRange( GL_ARRAY_BUFFER, 0, size, access ));
+
+    colors = nullptr;
+    if( !_glRenderConfig->_interleavedInstances )
+    {
+      glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesColors );
+      glBufferData( GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW );
+      colors = static_cast< GLubyte* >(
+          glMapBufferRange( GL_ARRAY_BUFFER, 0, size, access ));
+    }
+
+    if( !positions ||
+        ( !colors && !_glRenderConfig->_interleavedInstances ))
+    {
+      Log::log( "Instance buffers could not be mapped.", LOG_LEVEL_ERROR );
+
+      _unmapInstanceBuffers( );
+      return false;
+    }
+
+    return true;
+  }
+
+  void GLRenderer::_unmapInstanceBuffers( void )
+  {
+    if( _glRenderConfig->_persistentMapping )
+    {
+      // Coherent mappings need no flush. Instance attributes are pointed to
+      // the segment just written.
+      _instanceAttributes( _glRenderConfig->_ringSegment *
+                           _instanceSize( ) * _particles.size( ));
+      return;
+    }
+
+    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesPositions );
+    glUnmapBuffer( GL_ARRAY_BUFFER );
+
+    if( _glRenderConfig->_interleavedInstances )
+      return;
+
+    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesColors );
+    glUnmapBuffer( GL_ARRAY_BUFFER );
   }
 
   void GLRenderer::glRenderProgram( IGLRenderProgram* renderProgram )
@@ -124,9 +459,53 @@ namespace prefr
     if( _glRenderConfig )
     {
       _glRenderConfig->_glRenderProgram = _glRenderProgram;
+
+      // The requested format is restored once the program supports it.
+      if( _availableFormat( ) != _activeFormat )
+      {
+        _destroyInstanceBuffers( );
+        _createInstanceBuffers( );
+
+        glBindVertexArray( 0 );
+      }
     }
   }
 
+  GLRenderer::InstanceFormat GLRenderer::_availableFormat( void ) const
+  {
+    if( !_programSupports( _instanceFormat ))
+      return FLOAT_INSTANCES;
+
+    // Attributes of indexed instances are read through a buffer texture,
+    // whose size is limited by the implementation.
+    if( _instanceFormat == INDEXED_INSTANCES )
+    {
+      GLint maxTexels = 0;
+      glGetIntegerv( GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels );
+
+      if( GLint64( _particles.size( )) * attributePlanes > maxTexels )
+        return FLOAT_INSTANCES;
+    }
+
+    return _instanceFormat;
+  }
+
+  bool GLRenderer::_programSupports( InstanceFormat format ) const
+  {
+    if( !_glRenderProgram )
+      return true;
+
+    // Curve and indexed instances carry no color, which shaders read from
+    // the texture named by the program.
+    if( format == CURVE_INSTANCES )
+      return *_glRenderProgram->prefrCurvesTextureAlias( ) != '\0';
+
+    if( format == INDEXED_INSTANCES )
+      return *_glRenderProgram->prefrAttributesTextureAlias( ) != '\0';
+
+    return true;
+  }
+
   void GLRenderer::distanceArray( DistanceArray* distances )
   {
     assert( distances );
@@ -162,7 +541,82 @@ namespace prefr
     return _blendFunc;
   }
 
+  void GLRenderer::persistentMapping( bool enable )
+  {
+    _persistentMapping = enable;
+
+    if( _glRenderConfig && enable != _glRenderConfig->_persistentMapping )
+    {
+      _destroyInstanceBuffers( );
+      _createInstanceBuffers( );
+
+      glBindVertexArray( 0 );
+    }
+  }
+
+  bool GLRenderer::persistentMapping( void ) const
+  {
+    return _glRenderConfig && _glRenderConfig->_persistentMapping;
+  }
+
+  void GLRenderer::instanceFormat( InstanceFormat format )
+  {
+    bool changed = format != _instanceFormat;
+
+    _instanceFormat = format;
+
+    if( _glRenderConfig && changed )
+    {
+      _destroyInstanceBuffers( );
+      _createInstanceBuffers( );
+
+      glBindVertexArray( 0 );
+    }
+  }
+
+  GLRenderer::InstanceFormat GLRenderer::instanceFormat( void ) const
+  {
+    return _glRenderConfig ? _activeFormat : _instanceFormat;
+  }
+
   void GLRenderer::setupRender( void )
+  {
+    if( _glRenderConfig->_aliveParticles == 0 ||
+        _glRenderConfig->_deviceInstances )
+      return;
+
+    // Sorted particle data is gathered straight into the instance buffers.
+    GLubyte* positions;
+    GLubyte* colors;
+
+    if( !_mapInstanceBuffers( positions, colors ))
+      return;
+
+    if( _glRenderConfig->_curveInstances )
+    {
+      _bakeCurves( );
+      _curveInstances( positions );
+    }
+    else if( _glRenderConfig->_indexedInstances )
+    {
+      _uploadAttributes( );
+      _indexInstances( reinterpret_cast< GLuint* >( positions ));
+    }
+    else if( _glRenderConfig->_interleavedInstances )
+      _packInstances( positions );
+    else
+      _copyInstances( reinterpret_cast< GLfloat* >( positions ),
+                      reinterpret_cast< GLfloat* >( colors ));
+
+    glBindVertexArray( _glRenderConfig->_vao );
+
+    _unmapInstanceBuffers( );
+
+    glBindVertexArray( 0 );
+
+  }
+
+  void GLRenderer::_copyInstances( GLfloat* positions, GLfloat* colors )
   {
 #ifdef PREFR_USE_OPENMP
 
@@ -171,62 +625,290 @@ namespace prefr
 #endif
     for( int i = 0; i < ( int ) _glRenderConfig->_aliveParticles; ++i )
     {
-      tparticle currentParticle = _particles[ _distances->getID( i )];
+      ParticleRef currentParticle = _particles.ref( _distances->getID( i ));
+
+      glm::vec3 position = currentParticle.position( );
+      glm::vec4 color = currentParticle.color( );
 
       unsigned int idx = i * 4;
 
-      std::vector< GLfloat >::iterator posit =
-          _glRenderConfig->_particlePositions->begin( ) + idx;
+      GLfloat* posit = positions + idx;
 
-      *posit = currentParticle.position( ).x;
+      *posit = position.x;
       ++posit;
 
-      *posit = currentParticle.position( ).y;
+      *posit = position.y;
       ++posit;
 
-      *posit = currentParticle.position( ).z;
+      *posit = position.z;
       ++posit;
 
       *posit = currentParticle.size( );
-      ++posit;
 
-      std::vector< GLfloat >::iterator colorit =
-          _glRenderConfig->_particleColors->begin( ) + idx;
+      GLfloat* colorit = colors + idx;
 
-      *colorit = currentParticle.color( ).x;
+      *colorit = color.x;
       ++colorit;
 
-      *colorit = currentParticle.color( ).y;
+      *colorit = color.y;
       ++colorit;
 
-      *colorit = currentParticle.color( ).z;
+      *colorit = color.z;
       ++colorit;
 
-      *colorit = currentParticle.color( ).w;
-      ++colorit;
+      *colorit = color.w;
 
     }
+  }
 
-    glBindVertexArray( _glRenderConfig->_vao );
+  void GLRenderer::_packInstances( GLubyte* instances )
+  {
+    unsigned int aliveParticles = _glRenderConfig->_aliveParticles;
+    int batches = ( aliveParticles + packBatch - 1 ) / packBatch;
 
-    // Update positions buffer
-    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesPositions );
+    // Sorted attributes are gathered into arrays of each batch, which are
+    // then packed by the vectorized kernel.
+#ifdef PREFR_USE_OPENMP
 
-    glBufferSubData( GL_ARRAY_BUFFER,
-                     0,
-                     sizeof( GLfloat ) * _glRenderConfig->_aliveParticles * 4,
-                     &_glRenderConfig->_particlePositions->front( ));
+    #pragma omp parallel for if( _parallel )
 
-    // Update colors buffer
-    glBindBuffer( GL_ARRAY_BUFFER, _glRenderConfig->_vboParticlesColors );
+#endif
+    for( int batch = 0; batch < batches; ++batch )
+    {
+      unsigned int first = batch * packBatch;
+      unsigned int count = std::min( packBatch, aliveParticles - first );
+
+      float values[ 8 ][ packBatch ];
+
+      for( unsigned int j = 0; j < count; ++j )
+      {
+        ParticleRef particle = _particles.ref( _distances->getID( first + j ));
+
+        glm::vec3 position = particle.position( );
+        glm::vec4 color = particle.color( );
+
+        values[ 0 ][ j ] = position.x;
+        values[ 1 ][ j ] = position.y;
+        values[ 2 ][ j ] = position.z;
+        values[ 3 ][ j ] = particle.size( );
+        values[ 4 ][ j ] = color.x;
+        values[ 5 ][ j ] = color.y;
+        values[ 6 ][ j ] = color.z;
+        values[ 7 ][ j ] = color.w;
+      }
+
+      const float* arrays[ 8 ];
+      for( unsigned int c = 0; c < 8; ++c )
+        arrays[ c ] = values[ c ];
+
+      simd::packInstances( arrays,
+                           instances + first * simd::packedInstanceSize,
+                           count );
+    }
+  }
 
-    glBufferSubData( GL_ARRAY_BUFFER,
-                     0,
-                     sizeof( GLfloat ) * _glRenderConfig->_aliveParticles * 4,
-                     &_glRenderConfig->_particleColors->front( ));
+  void GLRenderer::_curveInstances( GLubyte* instances )
+  {
+    unsigned int aliveParticles = _glRenderConfig->_aliveParticles;
+    int batches = ( aliveParticles + packBatch - 1 ) / packBatch;
 
-    glBindVertexArray( 0 );
+    // Life is normalized with the particle model as the updater does, and
+    // converted to half floats per batch by the vectorized kernel.
+#ifdef PREFR_USE_OPENMP
+
+    #pragma omp parallel for if( _parallel )
+
+#endif
+    for( int batch = 0; batch < batches; ++batch )
+    {
+      unsigned int first = batch * packBatch;
+      unsigned int count = std::min( packBatch, aliveParticles - first );
+
+      glm::vec3 positions[ packBatch ];
+      float lives[ packBatch ];
+      unsigned short models[ packBatch ];
+      unsigned short halves[ packBatch ];
+
+      for( unsigned int j = 0; j < count; ++j )
+      {
+        unsigned int id = _distances->getID( first + j );
+        ParticleRef particle = _particles.ref( id );
+        Model* model = ( *_particleModels )[ id ];
+
+        positions[ j ] = particle.position( );
+        lives[ j ] = 0.0f;
+        models[ j ] = 0;
+
+        if( !model )
+          continue;
+
+        lives[ j ] = 1.0f -
+            glm::clamp( particle.life( ) * model->_lifeNormalization,
+                        0.0f, 1.0f );
+        models[ j ] = ( unsigned short ) model->_curvesIndex;
+      }
+
+      simd::halfFloats( lives, halves, count );
+
+      GLubyte* instance = instances + first * curveInstanceSize;
+      for( unsigned int j = 0; j < count; ++j )
+      {
+        memcpy( instance, &positions[ j ], 3 * sizeof( GLfloat ));
+        memcpy( instance + 12, &halves[ j ], sizeof( GLhalf ));
+        memcpy( instance + 14, &models[ j ], sizeof( GLushort ));
+
+        instance += curveInstanceSize;
+      }
+    }
+  }
+
+  void GLRenderer::_indexInstances( GLuint* instances )
+  {
+#ifdef PREFR_USE_OPENMP
+
+    #pragma omp parallel for if( _parallel )
+
+#endif
+    for( int i = 0; i < ( int ) _glRenderConfig->_aliveParticles; ++i )
+      instances[ i ] = _distances->getID( i );
+  }
+
+  void GLRenderer::_uploadAttributes( void )
+  {
+    if( !_particleData )
+      return;
+
+    GLsizeiptr capacity = _particles.size( );
+
+    // Buffers just created need every particle.
+    if( !_glRenderConfig->_attributesValid )
+    {
+      _changedSpans.assign( 1, IndexSpan( 0, ( unsigned int ) capacity ));
+      _glRenderConfig->_attributesValid = true;
+    }
+    else
+      _mergeChangedSpans( );
+
+    if( _changedSpans.empty( ))
+      return;
+
+    GLfloat* planes[ attributePlanes ];
+    GLRenderConfig::attributeArrays( *_particleData, planes );
+
+    // Particle arrays are split per component, so each plane is copied
+    // straight from them.
+    glBindBuffer( GL_TEXTURE_BUFFER, _glRenderConfig->_vboParticlesAttributes );
+
+    for( auto const& span : _changedSpans )
+    {
+      GLsizeiptr begin = span.begin;
+      GLsizeiptr end = std::min< GLsizeiptr >( span.end, capacity );
+
+      if( begin >= end )
+        continue;
+
+      for( unsigned int p = 0; p < attributePlanes; ++p )
+        glBufferSubData( GL_TEXTURE_BUFFER,
+                         ( p * capacity + begin ) * sizeof( GLfloat ),
+                         ( end - begin ) * sizeof( GLfloat ),
+                         planes[ p ] + begin );
+    }
+
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+
+    _changedSpans.clear( );
+  }
+
+  void GLRenderer::_bakeCurves( void )
+  {
+    if( !_models )
+      return;
+
+    // Sampling is skipped unless the models or their curves changed, so
+    // model indices are assigned along with the samples they refer to.
+    GLsizei rows = std::max( 2 * ( GLsizei ) _models->size( ), 2 );
+
+    if( !GLRenderConfig::curvesChanged( *_models,
+                                        _glRenderConfig->_curvesBaked ) &&
+        rows == _glRenderConfig->_curvesRows )
+      return;
+
+    // Each model takes two rows: the color curve, and the size curve in the
+    // red channel. Samples are baked lookup table entries, so that linear
+    // filtering reproduces InterpolationSet::GetLookupValue.
+    std::vector< glm::vec4 > texels( curveSamples * rows, glm::vec4( 0.0f ));
+
+    unsigned int index = 0;
+    for( Model* model : *_models )
+    {
+      model->_curvesIndex = index;
+
+      glm::vec4* colors = &texels[ 2 * index * curveSamples ];
+      glm::vec4* sizes = colors + curveSamples;
+
+      for( GLsizei j = 0; j < curveSamples; ++j )
+      {
+        float time = float( j ) / ( curveSamples - 1 );
+
+        colors[ j ] = model->color.GetLookupValue( time );
+        sizes[ j ].x = model->size.GetLookupValue( time );
+      }
+
+      ++index;
+    }
+
+    glBindTexture( GL_TEXTURE_2D, _glRenderConfig->_curvesTexture );
+
+    if( rows != _glRenderConfig->_curvesRows )
+    {
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F, curveSamples, rows, 0,
+                    GL_RGBA, GL_FLOAT, texels.data( ));
+
+      _glRenderConfig->_curvesRows = rows;
+    }
+    else
+      glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, curveSamples, rows,
+                       GL_RGBA, GL_FLOAT, texels.data( ));
+
+    glBindTexture( GL_TEXTURE_2D, 0 );
+  }
+
+  void GLRenderer::_bindTextures( IGLRenderProgram* program ) const
+  {
+    unsigned int programID = program->prefrGLProgramID( );
+
+    if( _glRenderConfig->_curveInstances )
+    {
+      int curvesID = glGetUniformLocation(
+          programID, program->prefrCurvesTextureAlias( ));
+
+      glActiveTexture( GL_TEXTURE0 );
+      glBindTexture( GL_TEXTURE_2D, _glRenderConfig->_curvesTexture );
+      glUniform1i( curvesID, 0 );
+    }
+    else if( _glRenderConfig->_indexedInstances )
+    {
+      int attributesID = glGetUniformLocation(
+          programID, program->prefrAttributesTextureAlias( ));
+
+      glActiveTexture( GL_TEXTURE0 );
+      glBindTexture( GL_TEXTURE_BUFFER, _glRenderConfig->_attributesTexture );
+      glUniform1i( attributesID, 0 );
+    }
+  }
+
+  void GLRenderer::_drawInstances( void ) const
+  {
+    if( !_glRenderConfig->_indirectBuffer )
+    {
+      glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4,
+                             _glRenderConfig->_aliveParticles );
+      return;
+    }
 
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, _glRenderConfig->_indirectBuffer );
+    glDrawArraysIndirect( GL_TRIANGLE_STRIP, nullptr );
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
   }
 
   void GLRenderer::paint( void ) const
@@ -271,10 +953,10 @@ namespace prefr
                    viewMatrix[ 1 ][ 0 ],
                    viewMatrix[ 2 ][ 0 ]);
 
+      _bindTextures( _glRenderProgram );
     }
 
-    glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4,
-                           _glRenderConfig->_aliveParticles );
+    _drawInstances( );
 
     glBindVertexArray( 0 );
 
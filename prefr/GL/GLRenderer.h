@@ -33,6 +33,7 @@ namespace prefr
 
   class GLRenderer : public Renderer
   {
+    friend class GLComputeParticleSystem;
 
   public:
 
@@ -42,6 +43,14 @@ namespace prefr
       ONE_MINUS_CONSTANT_ALPHA = 1
     };
 
+    enum InstanceFormat
+    {
+      FLOAT_INSTANCES = 0,
+      COMPACT_INSTANCES = 1,
+      CURVE_INSTANCES = 2,
+      INDEXED_INSTANCES = 3
+    };
+
     PREFR_API
     GLRenderer( );
 
@@ -63,15 +72,104 @@ namespace prefr
     virtual void alphaBlendingFunc( BlendFunc blendFunc );
     BlendFunc alphaBlendingFunc( void );
 
+    /*! \brief Enables or disables the upload of instance data through
+     * persistently mapped buffers.
+     *
+     * When enabled and GL_ARB_buffer_storage is available, instance buffers
+     * are mapped once and split into a ring of GLRenderConfig::ringSegments
+     * segments, each one guarded by a fence. Otherwise, buffers are orphaned
+     * and mapped on each upload. In both cases, sorted particle data is
+     * written straight into the mapped buffers. Enabled by default.
+     *
+     * @param enable true to use persistent mapping when available.
+     */
+    PREFR_API
+    void persistentMapping( bool enable );
+
+    /*! \brief Returns true if instance buffers are persistently mapped. */
+    PREFR_API
+    bool persistentMapping( void ) const;
+
+    /*! \brief Sets the format of the instance data uploaded each frame.
+     *
+     * FLOAT_INSTANCES uploads position and size, and color, as two float4
+     * streams (32 bytes per particle). COMPACT_INSTANCES uploads a single
+     * interleaved stream of simd::packedInstanceSize bytes per particle:
+     * position and size as half floats, and color as normalized bytes.
+     * Half floats keep 11 significant bits, so positions lose precision far
+     * from the origin (about 0.03 units at a distance of 64). Both formats
+     * are read by the same shaders.
+     *
+     * CURVE_INSTANCES uploads 16 bytes per particle: float position, the
+     * normalized life as a half float and the index of the particle model.
+     * Color and size curves of every model are sampled into a texture, so
+     * that the vertex shader evaluates them and updaters skip them on the
+     * CPU. The texture is sampled again only when the models or their
+     * curves change. This format needs the GLcurves shaders, or render and
+     * pick programs exposing IGLRenderProgram::prefrCurvesTextureAlias.
+     *
+     * INDEXED_INSTANCES keeps position, size and color of every particle in
+     * storage order on the GPU, and uploads only the particles updated since
+     * the last upload. Instance data are the sorted particle ids, 4 bytes
+     * per particle, so a moving camera over still particles uploads almost
+     * nothing. Attributes are read through a buffer texture of 8 floats per
+     * particle, so this format needs the GLindexed shaders, or programs
+     * exposing IGLRenderProgram::prefrAttributesTextureAlias. It falls back
+     * to FLOAT_INSTANCES if GL_MAX_TEXTURE_BUFFER_SIZE is too small.
+     *
+     * Both formats fall back to FLOAT_INSTANCES, with a warning, when the
+     * render program leaves the texture alias they need empty. The format
+     * requested is kept, and used again once a program names the alias.
+     *
+     * Defaults to FLOAT_INSTANCES.
+     *
+     * @param format Instance format.
+     */
+    PREFR_API
+    void instanceFormat( InstanceFormat format );
+
+    /*! \brief Returns the format of the uploaded instance data, which is
+     * FLOAT_INSTANCES if the requested format fell back to it. */
+    PREFR_API
+    InstanceFormat instanceFormat( void ) const;
+
   protected:
 
     void _init( void );
 
+    void _createInstanceBuffers( void );
+    void _destroyInstanceBuffers( void );
+
+    GLsizeiptr _instanceSize( void ) const;
+    void _instanceAttributes( GLintptr offset );
+
+    bool _mapInstanceBuffers( GLubyte*& positions, GLubyte*& colors );
+    void _unmapInstanceBuffers( void );
+
+    void _copyInstances( GLfloat* positions, GLfloat* colors );
+    void _packInstances( GLubyte* instances );
+    void _curveInstances( GLubyte* instances );
+    void _indexInstances( GLuint* instances );
+
+    InstanceFormat _availableFormat( void ) const;
+    bool _programSupports( InstanceFormat format ) const;
+
+    void _bakeCurves( void );
+    void _uploadAttributes( void );
+    void _bindTextures( IGLRenderProgram* program ) const;
+    void _drawInstances( void ) const;
+
     GLRenderConfig* _glRenderConfig;
     IGLRenderProgram* _glRenderProgram;
 
     unsigned int _blendFuncValue;
     BlendFunc _blendFunc;
+
+    bool _persistentMapping;
+
+    /*! Format requested, and format of the instance buffers created. */
+    InstanceFormat _instanceFormat;
+    InstanceFormat _activeFormat;
   };
 
 
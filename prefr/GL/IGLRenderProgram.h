@@ -58,11 +58,31 @@ namespace prefr
       return _viewMatrixRightComponentAlias.c_str( );
     }
 
+    /*! \brief Returns the name of the sampler reading the curves texture
+     * of GLRenderer::CURVE_INSTANCES. GLRenderer uses float instances
+     * instead while it is empty. */
+    PREFR_API virtual inline
+    const char* prefrCurvesTextureAlias( void ) const
+    {
+      return _curvesTextureAlias.c_str( );
+    }
+
+    /*! \brief Returns the name of the sampler reading the particle
+     * attributes of GLRenderer::INDEXED_INSTANCES. GLRenderer uses float
+     * instances instead when it is empty. */
+    PREFR_API virtual inline
+    const char* prefrAttributesTextureAlias( void ) const
+    {
+      return _attributesTextureAlias.c_str( );
+    }
+
   protected:
 
     std::string _viewProjectionMatrixAlias;
     std::string _viewMatrixUpComponentAlias;
     std::string _viewMatrixRightComponentAlias;
+    std::string _curvesTextureAlias;
+    std::string _attributesTextureAlias;
   };
 }
 
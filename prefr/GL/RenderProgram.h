@@ -42,6 +42,8 @@ namespace prefr
       _viewProjectionMatrixAlias = std::string( "modelViewProjM" );
       _viewMatrixUpComponentAlias = std::string( "cameraUp" );
       _viewMatrixRightComponentAlias = std::string( "cameraRight" );
+      _curvesTextureAlias = std::string( "curves" );
+      _attributesTextureAlias = std::string( "attributes" );
     }
 
     PREFR_API
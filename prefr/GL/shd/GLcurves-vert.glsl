@@ -0,0 +1,39 @@
+#version 330
+#extension GL_ARB_separate_shader_objects: enable
+
+uniform mat4 modelViewProjM;
+
+uniform vec3 cameraUp;
+uniform vec3 cameraRight;
+
+// Color and size curves of each model, in two rows per model.
+uniform sampler2D curves;
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 particlePosition;
+layout(location = 2) in float particleLife;
+layout(location = 3) in uint particleModel;
+
+
+out vec4 color;
+out vec2 uvCoord;
+
+void main()
+{
+	// Texel centers hold the curve samples, so linear filtering between
+	// them interpolates the curves as the CPU lookup tables do.
+	vec2 curvesSize = vec2(textureSize(curves, 0));
+	float u = (particleLife * (curvesSize.x - 1.0) + 0.5) / curvesSize.x;
+	float row = float(particleModel) * 2.0;
+
+	color = texture(curves, vec2(u, (row + 0.5) / curvesSize.y));
+	float size = texture(curves, vec2(u, (row + 1.5) / curvesSize.y)).r;
+
+	gl_Position = modelViewProjM 
+				* vec4(
+				(vertexPosition.x * size * cameraRight)
+				+ (vertexPosition.y * size * cameraUp)
+				+ particlePosition, 1.0);
+
+	uvCoord = vertexPosition.rg + vec2(0.5, 0.5);
+}
\ No newline at end of file
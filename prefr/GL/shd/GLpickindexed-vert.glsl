@@ -0,0 +1,44 @@
+#version 330
+#extension GL_ARB_separate_shader_objects: enable
+
+uniform mat4 modelViewProjM;
+
+uniform vec3 cameraUp;
+uniform vec3 cameraRight;
+
+// Position, size and color of every particle in storage order, one plane
+// per component.
+uniform samplerBuffer attributes;
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in uint particleId;
+
+
+out vec4 color;
+out vec2 uvCoord;
+
+out float id;
+
+float particleAttribute(int plane)
+{
+	int planeSize = textureSize(attributes) / 8;
+	return texelFetch(attributes, plane * planeSize + int(particleId)).r;
+}
+
+void main()
+{
+	vec3 position = vec3(particleAttribute(0), particleAttribute(1), particleAttribute(2));
+	float size = particleAttribute(3);
+
+	gl_Position = modelViewProjM 
+				* vec4(
+				(vertexPosition.x * size * cameraRight)
+				+ (vertexPosition.y * size * cameraUp)
+				+ position, 1.0);
+
+	color = vec4(particleAttribute(4), particleAttribute(5), particleAttribute(6), particleAttribute(7));
+
+	uvCoord = vertexPosition.rg + vec2(0.5, 0.5);
+
+	id = gl_InstanceID;
+}
\ No newline at end of file
@@ -67,15 +67,17 @@ namespace prefr
 
   void Cluster::killParticles( bool changeState )
   {
-    for( auto particle : _particles )
+    for( auto idx : _particles.indices( ))
     {
+      ParticleRef particle = _particles.ref( idx );
+
       particle.set_life( 0.0f );
 
       if( changeState )
       {
         particle.set_alive( false );
 
-        _updateConfig->setDead( particle.id( ), true );
+        _updateConfig->setDead( idx, true );
       }
     }
   }
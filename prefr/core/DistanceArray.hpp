@@ -32,6 +32,11 @@
 namespace prefr
 {
 
+  /*! \class DistanceUnit
+   *
+   * \brief Distance to the camera of a particle, stored along with the
+   * particle id so both are moved together when sorting.
+   */
   class DistanceUnit
   {
     friend class DistanceArray;
@@ -39,34 +44,39 @@ namespace prefr
   public:
 
     DistanceUnit( void )
-    {
-      _id = nullptr;
-      _distance = nullptr;
-    }
+    : _distance( -1.0f )
+    , _id( 0 )
+    { }
 
-    DistanceUnit( int* id_, float* distance_ )
-      : _id( id_ )
-      , _distance( distance_ )
-    {
-    }
+    DistanceUnit( int id_, float distance_ )
+    : _distance( distance_ )
+    , _id( id_ )
+    { }
 
-    const int& id( void ) const { return *_id; }
-    void id( int i ){ *_id = i; }
+    const int& id( void ) const { return _id; }
+    void id( int i ){ _id = i; }
 
-    const float& distance( void ) const { return *_distance; }
-    void distance( float d ){ *_distance = d; }
+    const float& distance( void ) const { return _distance; }
+    void distance( float d ){ _distance = d; }
 
   protected:
 
-    int* _id;
-    float* _distance;
-
+    float _distance;
+    int _id;
 
   };
 
   typedef DistanceUnit TDistUnit;
   typedef std::vector< TDistUnit > TDistUnitContainer;
 
+  /*! \class DistanceArray
+   *
+   * \brief Contiguous array of particle distances and ids to be sorted.
+   *
+   * Distances of each frame are written as a prefix of the array, from the
+   * first element up to current, and only that prefix is sorted and
+   * rendered. Elements beyond it keep stale values and are not cleared.
+   */
   class DistanceArray
   {
   public:
@@ -75,23 +85,9 @@ namespace prefr
                    ICamera* camera = nullptr )
     : _camera( camera )
     {
-      ids.resize( size );
-      distances.resize( size );
       elements.resize( size );
       current = 0;
       currentIt = elements.begin( );
-
-      std::vector< int >::iterator currentId = ids.begin( );
-      std::vector< float >::iterator currentDist = distances.begin( );
-
-      for( TDistUnitContainer::iterator element = elements.begin( );
-           element != elements.end( );
-           ++element, ++currentId, ++currentDist )
-      {
-        ( *element )._id = &( *currentId );
-        ( *element )._distance = &( *currentDist );
-      }
-
     }
 
     virtual ~DistanceArray( void )
@@ -120,22 +116,19 @@ namespace prefr
 
     virtual inline const int& getID( unsigned int i ) const
     {
-      return elements[ i ].id( );
+      return elements[ i ]._id;
     }
 
     virtual inline const float& getDistance( unsigned int i ) const
     {
-      return elements[ i ].distance( );
+      return elements[ i ]._distance;
     }
 
+    /*! \brief Restarts writing distances from the first element. */
     inline void resetCounter( void )
     {
       current = 0;
       currentIt = elements.begin( );
-
-      //TODO find something more efficient
-      for( auto& dist : distances )
-        dist = -1;
     }
 
     inline DistanceUnit* next( void )
@@ -151,18 +144,15 @@ namespace prefr
     inline static bool sortDescending ( const DistanceUnit& lhs,
                                         const DistanceUnit& rhs )
     {
-      return *lhs._distance > *rhs._distance;
+      return lhs._distance > rhs._distance;
     }
 
     inline static bool sortAscending ( const DistanceUnit& lhs,
                                        const DistanceUnit& rhs)
     {
-      return *lhs._distance < *rhs._distance;
+      return lhs._distance < rhs._distance;
     }
 
-    std::vector< int > ids;
-    std::vector< float > distances;
-
     TDistUnitContainer elements;
     TDistUnitContainer::iterator currentIt;
 
@@ -29,9 +29,11 @@ namespace prefr
   , _maxLife( 0.0f )
   , _lifeRange( 0.0f )
   , _lifeNormalization( 1.0f )
+  , _curvesIndex( 0 )
   { }
 
   Model::Model( float min, float max )
+  : _curvesIndex( 0 )
   {
     setLife( min, max );
   }
@@ -66,5 +68,12 @@ namespace prefr
   {
     return _lifeRange;
   }
+
+  void Model::bake( void )
+  {
+    size.Bake( );
+    velocity.Bake( );
+    color.Bake( );
+  }
 }
 
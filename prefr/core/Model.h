@@ -58,6 +58,8 @@ namespace prefr
   class Model
   {
     friend class Updater;
+    friend class GLRenderer;
+    friend class GLComputeParticleSystem;
 
   public:
 
@@ -122,6 +124,16 @@ namespace prefr
      */
     PREFR_API float inverseMaxLife( void );
 
+    /*! \brief Bakes the lookup tables of the modified curves.
+     *
+     * Rebuilds the lookup tables of the curves modified since the last call.
+     * ParticleSystem calls it for its models before updating particles, so
+     * that updaters evaluate curves in constant time.
+     *
+     * Re-implement to bake curves added by derived models.
+     */
+    PREFR_API virtual void bake( void );
+
     /*! InterpolationSet defining size values. */
     vectortfloat size;
 
@@ -145,6 +157,9 @@ protected:
     /*! Attribute storing the inverse of the life range. */
     float _lifeNormalization;
 
+    /*! Index of the model curves within the texture baked by GLRenderer. */
+    unsigned int _curvesIndex;
+
   };
 
   typedef VectorizedSet< Model* > ModelsArray;
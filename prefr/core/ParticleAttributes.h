@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __PREFR__PARTICLE_ATTRIBUTES__
+#define __PREFR__PARTICLE_ATTRIBUTES__
+
+#include "../utils/types.h"
+#include "../utils/AlignedAllocator.h"
+#include "../utils/SplitVector.hpp"
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace prefr
+{
+  /*! Alignment in bytes of the particle attribute arrays. */
+  static const size_t attributeAlignment = 64;
+
+  /*! Aligned array storing a particle attribute. */
+  template< typename T >
+  using AttributeVector =
+      std::vector< T, AlignedAllocator< T, attributeAlignment >>;
+
+  /*! Aligned arrays storing each component of a vector particle attribute. */
+  template< typename T >
+  using SplitAttributeVector =
+      SplitVector< T, AlignedAllocator< typename T::value_type,
+                                        attributeAlignment >>;
+
+  /*! \brief Storage, pointer and reference types used for an attribute of
+   * the given type. Vector types are split into one array per component.
+   */
+  template< typename T >
+  struct AttributeTraits
+  {
+    typedef AttributeVector< T > vector;
+    typedef T* pointer;
+    typedef T& reference;
+  };
+
+  template< >
+  struct AttributeTraits< TVect3 >
+  {
+    typedef SplitAttributeVector< TVect3 > vector;
+    typedef SplitPointer< TVect3 > pointer;
+    typedef SplitReference< TVect3 > reference;
+  };
+
+  template< >
+  struct AttributeTraits< TVect4 >
+  {
+    typedef SplitAttributeVector< TVect4 > vector;
+    typedef SplitPointer< TVect4 > pointer;
+    typedef SplitReference< TVect4 > reference;
+  };
+
+  /*! Tag types identifying particle attributes and their stored type. */
+  namespace attrib
+  {
+    struct Id { typedef unsigned int type; };
+    struct Life { typedef float type; };
+    struct Size { typedef float type; };
+    struct Position { typedef TVect3 type; };
+    struct Color { typedef TVect4 type; };
+    struct VelocityModule { typedef float type; };
+    struct Velocity { typedef TVect3 type; };
+    struct AccelerationModule { typedef float type; };
+    struct Acceleration { typedef TVect3 type; };
+    struct Alive { typedef char type; };
+  }
+
+  template< typename Tag, typename... Attribs >
+  struct _AttributeIndex;
+
+  template< typename Tag, typename... Attribs >
+  struct _AttributeIndex< Tag, Tag, Attribs... >
+  : std::integral_constant< unsigned int, 0 >
+  { };
+
+  template< typename Tag, typename First, typename... Attribs >
+  struct _AttributeIndex< Tag, First, Attribs... >
+  : std::integral_constant< unsigned int,
+                            1 + _AttributeIndex< Tag, Attribs... >::value >
+  { };
+
+  template< typename Tag, typename... Attribs >
+  struct _HasAttribute : std::false_type
+  { };
+
+  template< typename Tag, typename First, typename... Attribs >
+  struct _HasAttribute< Tag, First, Attribs... >
+  : std::integral_constant< bool, std::is_same< Tag, First >::value ||
+                                  _HasAttribute< Tag, Attribs... >::value >
+  { };
+
+  /*! \class ParticleSchema
+   *
+   * \brief Compile-time set of particle attributes.
+   *
+   * Lists the attribute tags stored for each particle. Storage, iterators
+   * and spans are generated from this list, so attributes not listed take
+   * neither memory nor iterator space.
+   *
+   * @see ParticleAttributes
+   */
+  template< typename... Attribs >
+  struct ParticleSchema
+  {
+    static const unsigned int size = sizeof...( Attribs );
+
+    /*! True if the schema contains the given attribute. */
+    template< typename Tag >
+    struct has : _HasAttribute< Tag, Attribs... >
+    { };
+
+    /*! Position of the given attribute within the schema. */
+    template< typename Tag >
+    struct index : _AttributeIndex< Tag, Attribs... >
+    { };
+
+    typedef std::tuple<
+        typename AttributeTraits< typename Attribs::type >::vector... > Vectors;
+
+    typedef std::tuple<
+        typename AttributeTraits< typename Attribs::type >::pointer... > Pointers;
+  };
+
+  /*! Attributes stored by prefr::Particles. Acceleration attributes are not
+   * used by the built-in updater, and are only stored when the library is
+   * built with PREFR_WITH_ACCELERATION. */
+  typedef ParticleSchema< attrib::Id,
+                          attrib::Life,
+                          attrib::Size,
+                          attrib::Position,
+                          attrib::Color,
+                          attrib::VelocityModule,
+                          attrib::Velocity,
+#ifdef PREFR_WITH_ACCELERATION
+                          attrib::AccelerationModule,
+                          attrib::Acceleration,
+#endif
+                          attrib::Alive > ParticleAttributes;
+
+  /*! \brief Calls f( std::get< i >( tuple ) ) for each tuple element. */
+  template< unsigned int I = 0, typename F, typename... T >
+  inline typename std::enable_if< I == sizeof...( T )>::type
+  forEachAttribute( std::tuple< T... >&, F& )
+  { }
+
+  template< unsigned int I = 0, typename F, typename... T >
+  inline typename std::enable_if< I < sizeof...( T )>::type
+  forEachAttribute( std::tuple< T... >& tuple, F& f )
+  {
+    f( std::get< I >( tuple ));
+    forEachAttribute< I + 1 >( tuple, f );
+  }
+
+  /*! \brief Calls f( std::get< i >( first ), std::get< i >( second )) for
+   * each pair of tuple elements. */
+  template< unsigned int I = 0, typename F, typename... T, typename... U >
+  inline typename std::enable_if< I == sizeof...( T )>::type
+  forEachAttribute( std::tuple< T... >&, std::tuple< U... >&, F& )
+  { }
+
+  template< unsigned int I = 0, typename F, typename... T, typename... U >
+  inline typename std::enable_if< I < sizeof...( T )>::type
+  forEachAttribute( std::tuple< T... >& first, std::tuple< U... >& second,
+                    F& f )
+  {
+    f( std::get< I >( first ), std::get< I >( second ));
+    forEachAttribute< I + 1 >( first, second, f );
+  }
+
+  template< typename... Attribs >
+  const unsigned int ParticleSchema< Attribs... >::size;
+
+}
+
+#endif /* __PREFR__PARTICLE_ATTRIBUTES__ */
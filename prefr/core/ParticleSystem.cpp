@@ -30,6 +30,8 @@
 
 namespace prefr
 {
+  // Maximum number of consecutive particles processed by each parallel task.
+  static const unsigned int parallelSpanLength = 4096;
 
   ParticleSystem::ParticleSystem( unsigned int maxParticles,
                                   ICamera* camera )
@@ -43,6 +45,7 @@ namespace prefr
 #ifdef PREFR_USE_OPENMP
   , _parallel( true )
 #endif
+  , _fuseCameraDistances( false )
   {
 
     _particles.resize( _maxParticles );
@@ -68,13 +71,12 @@ namespace prefr
     _updateConfig._used = &_used;
     _updateConfig._unused = &_unused;
 
-    auto particle = _particles.begin( );
     for( unsigned int i = 0; i < _maxParticles; i++ )
     {
+      ParticleRef particle = _particles.ref( i );
+
       particle.set_id( i );
       particle.set_alive( false );
-
-      ++particle;
     }
 
     _aliveParticles = 0;
@@ -143,30 +145,44 @@ namespace prefr
 
     if( indices.size( ) > 0 )
     {
+      std::set< Source* > previousSources;
+
       for( unsigned int idx : indices )
       {
         if( !_unused.hasElement( idx ))
         {
           Source* previous = _referenceSources[ idx ];
           if( previous )
+          {
             previous->particles( ).removeIndex( idx );
+            previousSources.insert( previous );
+          }
         }
 
-        _flagsDead[ idx ] = true;
-        _flagsEmitted[ idx ] = false;
+        _flagsDead.set( idx, true );
+        _flagsEmitted.set( idx, false );
 
         _referenceSources[ idx ] = source;
       }
 
+      _updateConfig._referencesChanged = true;
+
       _unused.removeIndices( source->particles( ).indices( ));
       _used.addIndices( indices );
 
+      for( auto previous : previousSources )
+        if( previous != source )
+          previous->_rebuildFreeIndices( );
+
     }
 
     _sources.push_back( source );
 
     source->active( true );
 
+    if( _sorter )
+      _sorter->_particlesChanged = true;
+
     source->_initializeParticles( );
   }
 
@@ -179,6 +195,9 @@ namespace prefr
     _sources.remove( source );
 
     source->active( false );
+
+    if( _sorter )
+      _sorter->_particlesChanged = true;
   }
 
   void ParticleSystem::addModel( Model* model )
@@ -192,21 +211,26 @@ namespace prefr
     assert( model );
     _models.remove( model );
 
-    for( auto const & particle : _used )
-    {
-      unsigned int idx = particle.id( );
+    // Gather first, as removing from _used while iterating it would
+    // invalidate the iteration.
+    ParticleSet detached;
 
+    for( auto idx : _used.indices( ))
+    {
       if( _referenceModels[ idx ] == model )
       {
         _referenceModels[ idx ] = nullptr;
 
-        _flagsDead[ idx ] = false;
-        _flagsEmitted[ idx ] = false;
+        _flagsDead.set( idx, false );
+        _flagsEmitted.set( idx, false );
 
-        _used.removeIndex( idx );
-        _unused.addIndex( idx );
+        detached.insert( idx );
       }
     }
+
+    _used.transferIndicesTo( _unused, detached );
+
+    _updateConfig._referencesChanged = true;
   }
 
   void ParticleSystem::addUpdater( Updater* updater )
@@ -222,21 +246,26 @@ namespace prefr
   {
     assert( updater );
 
-    for( auto const & particle : _used )
-    {
-      unsigned int idx = particle.id( );
+    // Gather first, as removing from _used while iterating it would
+    // invalidate the iteration.
+    ParticleSet detached;
 
+    for( auto idx : _used.indices( ))
+    {
       if( _referenceUpdaters[ idx ] == updater )
       {
         _referenceUpdaters[ idx ] = nullptr;
 
-        _flagsDead[ idx ] = false;
-        _flagsEmitted[ idx ] = false;
+        _flagsDead.set( idx, false );
+        _flagsEmitted.set( idx, false );
 
-        _used.removeIndex( idx );
-        _unused.addIndex( idx );
+        detached.insert( idx );
       }
     }
+
+    _used.transferIndicesTo( _unused, detached );
+
+    _updateConfig._referencesChanged = true;
   }
 
 
@@ -255,6 +284,7 @@ namespace prefr
     _sorter->_parallel = _parallel;
 #endif
 
+    _sorter->_compactAlive = _updateConfig._compactAlive;
   }
 
   Sorter* ParticleSystem::sorter( void ) const
@@ -268,6 +298,9 @@ namespace prefr
     _renderer = renderer_ ;
 
     _renderer->particles( _particles );
+    _renderer->_models = &_models;
+    _renderer->_particleModels = &_referenceModels;
+    _renderer->_particleData = &_particles;
 
     _renderer->_init( );
 
@@ -316,11 +349,29 @@ namespace prefr
   {
     _aliveParticles = 0;
 
-#ifdef PREFR_USE_OPENMP
+    _updateConfig._random.nextFrame( );
+
+    // Curves cannot be baked concurrently, so do it before updating.
+    for( auto model : _models )
+      model->bake( );
 
     _sourcesVec = _sources.vector( );
     _sorter->sources( &_sourcesVec );
 
+    _updateConfig._renderCurves =
+        !_renderer || !_renderer->_evaluatesCurves;
+
+    // Updaters compute sort keys while particles are still in cache.
+    _sorter->_keysValid = false;
+    _updateConfig._sorter = nullptr;
+
+    if( _fuseCameraDistances && _camera )
+    {
+      _sorter->_prepareKeys( _camera->PReFrCameraPosition( ));
+      _updateConfig._sorter = _sorter;
+    }
+
+#ifdef PREFR_USE_OPENMP
     #pragma omp parallel for if( _parallel )
     for( int s = 0; s < ( int ) _sources.size( ); ++s )
     {
@@ -340,34 +391,125 @@ namespace prefr
 
   void ParticleSystem::updateFrame( float deltaTime )
   {
+    if( _updateConfig._compactAlive )
+    {
+      _updateAliveFrame( deltaTime );
+      return;
+    }
+
+#ifdef PREFR_USE_OPENMP
+    IndexSpans spans = _used.spans( parallelSpanLength );
+
+    #pragma omp parallel for if( _parallel ) schedule( dynamic )
+    for( int s = 0; s < ( int ) spans.size( ); ++s )
+    {
+      const IndexSpan& span = spans[ s ];
+#else
+    for( auto const& span : _used.spans( ))
+    {
+#endif
+      unsigned int idx = span.begin;
+      while( idx < span.end )
+      {
+        // Group consecutive particles sharing source, model and updater.
+        Source* source = _referenceSources[ idx ];
+        Model* model = _referenceModels[ idx ];
+        Updater* updater = _referenceUpdaters[ idx ];
+
+        unsigned int end = idx + 1;
+        while( end < span.end && _referenceSources[ end ] == source &&
+               _referenceModels[ end ] == model &&
+               _referenceUpdaters[ end ] == updater )
+          ++end;
+
+        if( source && updater && source->active( ) &&
+            !source->particles( ).empty( ))
+        {
+          updater->updateRange( _particles.span( idx, end ), source, model,
+                                deltaTime );
+        }
+
+        idx = end;
+      }
+    }
+
+  }
 
+  void ParticleSystem::_updateAliveFrame( float deltaTime )
+  {
+    // Sorted alive lists let consecutive particles be updated in batches.
 #ifdef PREFR_USE_OPENMP
     #pragma omp parallel for if( _parallel )
-    for( int particleId = 0; particleId < ( int ) _used.size( ); ++particleId )
+    for( int s = 0; s < ( int ) _sourcesVec.size( ); ++s )
     {
-      tparticle particle = _used[ particleId ];
+      Source* source = _sourcesVec[ s ];
 #else
-    for( auto particle : _used )
+    for( auto source : _sourcesVec )
     {
 #endif
+      if( !source->particles( ).empty( ) && source->active( ))
+        source->_aliveIndices.sort( );
+    }
 
-      Source* source = _referenceSources[ particle.id( )];
-      if( !source || !source->active( ) || source->particles( ).empty( ))
+    _aliveRuns.clear( );
+
+    for( auto source : _sourcesVec )
+    {
+      if( source->particles( ).empty( ) || !source->active( ))
         continue;
 
-      Updater* updater = _referenceUpdaters[ particle.id( )];
-      if( updater )
-        updater->updateParticle( particle, deltaTime );
+      const std::vector< unsigned int >& indices =
+          source->_aliveIndices.vector( );
 
+      size_t i = 0;
+      while( i < indices.size( ))
+      {
+        unsigned int idx = indices[ i++ ];
+
+        // Particles might have been moved to another source since emission.
+        if( _referenceSources[ idx ] != source || !_referenceUpdaters[ idx ])
+          continue;
+
+        // Group consecutive particles sharing model and updater.
+        Model* model = _referenceModels[ idx ];
+        Updater* updater = _referenceUpdaters[ idx ];
+
+        unsigned int end = idx + 1;
+        while( i < indices.size( ) && indices[ i ] == end &&
+               end - idx < parallelSpanLength &&
+               _referenceSources[ end ] == source &&
+               _referenceModels[ end ] == model &&
+               _referenceUpdaters[ end ] == updater )
+        {
+          ++end;
+          ++i;
+        }
+
+        _aliveRuns.push_back( IndexSpan( idx, end ));
+      }
     }
 
+#ifdef PREFR_USE_OPENMP
+    #pragma omp parallel for if( _parallel ) schedule( dynamic )
+#endif
+    for( int r = 0; r < ( int ) _aliveRuns.size( ); ++r )
+    {
+      const IndexSpan& run = _aliveRuns[ r ];
+
+      _referenceUpdaters[ run.begin ]->updateRange(
+          _particles.span( run.begin, run.end ),
+          _referenceSources[ run.begin ], _referenceModels[ run.begin ],
+          deltaTime );
+    }
   }
 
   void ParticleSystem::finishFrame( void )
   {
+    unsigned int aliveParticles = 0;
+
     // For each source...
 #ifdef PREFR_USE_OPENMP
-    #pragma omp parallel for if( _parallel )
+    #pragma omp parallel for if( _parallel ) reduction( + : aliveParticles )
 
     for( int s = 0; s < ( int ) _sources.size( ); ++s )
     {
@@ -382,14 +524,49 @@ namespace prefr
       // Finish frame
       source->closeFrame( );
 
-      #pragma omp atomic
-      _aliveParticles += source->aliveParticles( );
+      aliveParticles += source->aliveParticles( );
 
     }
 
+    _aliveParticles += aliveParticles;
+
     _sorter->_aliveParticles = _aliveParticles;
+    _sorter->_particlesChanged = true;
     _renderer->renderConfig( )->_aliveParticles = _aliveParticles;
 
+    if( _renderer->_tracksChanges )
+      _reportChanges( );
+  }
+
+  void ParticleSystem::_reportChanges( void )
+  {
+    // Renderers keeping particles in storage order upload only the particles
+    // updated this frame that are going to be rendered.
+    if( _renderDeadParticles )
+    {
+      for( auto const& span : _used.spans( ))
+        _renderer->_particlesChanged( span.begin, span.end );
+    }
+    else if( _updateConfig._compactAlive )
+    {
+      for( auto const& run : _aliveRuns )
+        _renderer->_particlesChanged( run.begin, run.end );
+    }
+    else
+    {
+      for( auto const& span : _used.spans( ))
+      {
+        size_t idx = _flagsDead.findNext( span.begin, span.end, false );
+        while( idx < span.end )
+        {
+          size_t end = _flagsDead.findNext( idx, span.end, true );
+          _renderer->_particlesChanged( idx, end );
+
+          idx = _flagsDead.findNext( end, span.end, false );
+        }
+      }
+    }
+
   }
 
   void ParticleSystem::updateCameraDistances( const glm::vec3& cameraPosition )
@@ -450,6 +627,48 @@ namespace prefr
       _renderer->_parallel = parallelProcessing;
   }
 
+  void ParticleSystem::compactAliveParticles( bool compact )
+  {
+    if( _updateConfig._compactAlive == compact )
+      return;
+
+    _updateConfig._compactAlive = compact;
+
+    if( _sorter )
+    {
+      _sorter->_compactAlive = compact;
+      _sorter->_particlesChanged = true;
+    }
+
+    for( auto source : _sources )
+      source->_rebuildAliveIndices( );
+  }
+
+  bool ParticleSystem::compactAliveParticles( void ) const
+  {
+    return _updateConfig._compactAlive;
+  }
+
+  void ParticleSystem::fuseCameraDistances( bool fuse )
+  {
+    _fuseCameraDistances = fuse;
+  }
+
+  bool ParticleSystem::fuseCameraDistances( void ) const
+  {
+    return _fuseCameraDistances;
+  }
+
+  void ParticleSystem::randomSeed( unsigned int seed )
+  {
+    _updateConfig._random.seed( seed );
+  }
+
+  unsigned int ParticleSystem::randomSeed( void ) const
+  {
+    return _updateConfig._random.seed( );
+  }
+
   const ClustersArray& ParticleSystem::clusters( void ) const
   {
     return _clusters;
@@ -467,16 +686,20 @@ namespace prefr
 
   void ParticleSystem::releaseParticles( const ParticleSet& indices )
   {
-    for( auto const & idx : indices )
+    indices.forEachSpan( [ this ]( unsigned int begin, unsigned int end )
     {
-      _referenceModels[ idx ] = nullptr;
-      _referenceSources[ idx ] = nullptr;
-      _referenceUpdaters[ idx ] = nullptr;
+      std::fill( _referenceModels.begin( ) + begin,
+                 _referenceModels.begin( ) + end, nullptr );
+      std::fill( _referenceSources.begin( ) + begin,
+                 _referenceSources.begin( ) + end, nullptr );
+      std::fill( _referenceUpdaters.begin( ) + begin,
+                 _referenceUpdaters.begin( ) + end, nullptr );
 
-      _flagsDead[ idx ] = false;
-      _flagsEmitted[ idx ] = false;
+      _flagsDead.fill( begin, end, false );
+      _flagsEmitted.fill( begin, end, false );
+    });
 
-    }
+    _updateConfig._referencesChanged = true;
 
     _used.removeIndices( indices);
     _unused.addIndices( indices );
@@ -494,14 +717,15 @@ namespace prefr
 
     ParticleSet indices;
 
-    for( auto particleId : _unused.indices( ) )
+    for( auto const& span : _unused.spans( ))
     {
       if( count >= size )
         break;
 
-      indices.append( particleId );
+      unsigned int length = std::min( span.size( ), size - count );
+      indices.insert( span.begin, span.begin + length );
 
-      ++count;
+      count += length;
     }
 //
 //    _unused.removeIndices( indices );
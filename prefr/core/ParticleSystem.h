@@ -368,6 +368,76 @@ namespace prefr
     PREFR_API
     void parallel( bool parallelProcessing );
 
+    /*! \brief Activates the compaction of alive particles.
+     *
+     * Activates the compaction of alive particles. When activated, each
+     * source keeps a dense list of its alive particles, so update and
+     * sorting stages only traverse alive particles instead of the whole
+     * pool. Particle ids are not modified. By default, compaction is
+     * deactivated.
+     *
+     * Note: Compaction is ignored by the sorter when rendering dead
+     * particles.
+     *
+     * @param compact true to activate, false to deactivate.
+     */
+    PREFR_API
+    void compactAliveParticles( bool compact );
+
+    /*! \brief Sets the seed of the random numbers used by the system.
+     *
+     * Sets the seed of the random numbers generated for emitted particles
+     * and restarts the frame count. Random numbers only depend on the seed,
+     * the particle id and the frame, and sources emit dead particles in an
+     * order fixed by their ids, so the simulation is reproducible
+     * regardless of the number of threads used.
+     *
+     * @param seed Seed of the random numbers.
+     */
+    PREFR_API
+    void randomSeed( unsigned int seed );
+
+    /*! \brief Returns the seed of the random numbers used by the system.
+     *
+     * @return Seed of the random numbers.
+     */
+    PREFR_API
+    unsigned int randomSeed( void ) const;
+
+    /*! \brief Returns true if alive particles compaction is active.
+     *
+     * Returns true if alive particles compaction is active.
+     *
+     * @return true if active, false if not.
+     */
+    PREFR_API
+    bool compactAliveParticles( void ) const;
+
+    /*! \brief Activates computing camera distances during the update.
+     *
+     * Activates computing camera distances during the update. When
+     * activated, updaters compute the sort key of each particle right after
+     * moving it, from the position of the ICamera object, and
+     * updateCameraDistances only gathers those keys instead of reading
+     * every position again. Keys are computed again by the sorter if the
+     * camera moved between update and updateCameraDistances. Requires an
+     * ICamera object. By default, deactivated.
+     *
+     * @param fuse true to activate, false to deactivate.
+     *
+     * @see Sorter::distanceKey
+     */
+    PREFR_API
+    void fuseCameraDistances( bool fuse );
+
+    /*! \brief Returns true if camera distances are computed during the
+     * update.
+     *
+     * @return true if active, false if not.
+     */
+    PREFR_API
+    bool fuseCameraDistances( void ) const;
+
     /*! \brief Returns the collection of cluster objects.
      *
      * Returns the collection of cluster objects.
@@ -410,6 +480,9 @@ namespace prefr
     virtual void updateFrame( float deltaTime );
     virtual void finishFrame( void );
 
+    void _updateAliveFrame( float deltaTime );
+    void _reportChanges( void );
+
     /*! Particles collection the system will manage. */
     Particles _particles;
 
@@ -428,6 +501,10 @@ namespace prefr
     /*! Updater objects collection of the system. */
     UpdatersArray _updaters;
 
+    /*! Runs of consecutive alive particles sharing source, model and
+     * updater, updated when alive compaction is enabled. */
+    IndexSpans _aliveRuns;
+
     /*! Particle Sorter for composition rendering. */
     Sorter* _sorter;
 
@@ -466,6 +543,9 @@ namespace prefr
     /*! Flag indicating if the system will run concurrently. */
     bool _parallel;
 
+    /*! Flag indicating if camera distances are computed by updaters. */
+    bool _fuseCameraDistances;
+
     unsigned int _lastAlive;
 
     unsigned int _noVariationFrames;
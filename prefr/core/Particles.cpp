@@ -27,6 +27,60 @@
 namespace prefr
 {
 
+  namespace
+  {
+    struct ResizeAttribute
+    {
+      unsigned int size;
+
+      template< typename V >
+      void operator()( V& vector )
+      {
+        vector.resize( size );
+      }
+    };
+
+    struct ClearAttribute
+    {
+      template< typename V >
+      void operator()( V& vector )
+      {
+        vector.clear( );
+      }
+    };
+
+    struct AttributeData
+    {
+      template< typename V, typename P >
+      void operator()( V& vector, P& pointer )
+      {
+        pointer = vector.data( );
+      }
+    };
+
+    struct OffsetAttribute
+    {
+      int offset;
+
+      template< typename P >
+      void operator()( const P& base, P& pointer )
+      {
+        pointer = base + offset;
+      }
+    };
+
+    struct AdvanceAttribute
+    {
+      int offset;
+
+      template< typename P >
+      void operator()( P& pointer )
+      {
+        pointer += offset;
+      }
+    };
+  }
+
   Particles::Particles( )
   : _size( 0 )
   { }
@@ -48,16 +102,8 @@ namespace prefr
 
   void Particles::resize( unsigned int newSize )
   {
-    _idVector.resize( newSize );
-    _lifeVector.resize( newSize, 0.0f );
-    _sizeVector.resize( newSize, 0.0f );
-    _positionVector.resize( newSize, TVect3( 0, 0, 0) );
-    _colorVector.resize( newSize, TVect4( 0, 0, 0, 0) );
-    _velocityModuleVector.resize( newSize, 0.0f );
-    _velocityVector.resize( newSize, TVect3( 0, 0, 0));
-    _accelerationModuleVector.resize( newSize, 0.0f );
-    _accelerationVector.resize( newSize, TVect3( 0, 0, 0) );
-    _aliveVector.resize( newSize, false );
+    ResizeAttribute resizeAttribute{ newSize };
+    forEachAttribute( _attributes, resizeAttribute );
 
     initVectorReferences( );
 
@@ -66,16 +112,8 @@ namespace prefr
 
   void Particles::clear( void )
   {
-    _idVector.clear( );
-    _lifeVector.clear( );
-    _sizeVector.clear( );
-    _positionVector.clear( );
-    _colorVector.clear( );
-    _velocityModuleVector.clear( );
-    _velocityVector.clear( );
-    _accelerationModuleVector.clear( );
-    _accelerationVector.clear( );
-    _aliveVector.clear( );
+    ClearAttribute clearAttribute;
+    forEachAttribute( _attributes, clearAttribute );
 
     _size = 0;
   }
@@ -129,6 +167,31 @@ namespace prefr
     return _createIterator( i );
   }
 
+  ParticleSpan Particles::span( unsigned int begin, unsigned int end )
+  {
+    assert( begin <= end && end <= _size );
+
+    ParticleSpan result;
+
+    result.data = this;
+    result.begin = begin;
+    result.length = end - begin;
+
+    result.attributes = _vectorReferences;
+
+    AdvanceAttribute advanceAttribute{ ( int ) begin };
+    forEachAttribute( result.attributes, advanceAttribute );
+
+    return result;
+  }
+
+  ParticleRef Particles::ref( unsigned int i )
+  {
+    assert( i < _size );
+
+    return ParticleRef( this, i );
+  }
+
   Particles::iterator
   Particles::_createIterator( unsigned int i ) const
   {
@@ -154,17 +217,8 @@ namespace prefr
 
   void Particles::initVectorReferences( void )
   {
-    _vectorReferences = std::make_tuple( _idVector.data( ),
-                                         _lifeVector.data( ),
-                                         _sizeVector.data( ),
-                                         _positionVector.data( ),
-                                         _colorVector.data( ),
-                                         _velocityModuleVector.data( ),
-                                         _velocityVector.data( ),
-                                         _accelerationModuleVector.data( ),
-                                         _accelerationVector.data( ),
-                                         _aliveVector.data( ));
-
+    AttributeData attributeData;
+    forEachAttribute( _attributes, _vectorReferences, attributeData );
   }
 
   // BASE_ITERATOR
@@ -176,16 +230,8 @@ namespace prefr
   , _vectorRef( )
   , _indexPosition( 0 )
   , _particleIndices( nullptr )
-  , _id_ptr( nullptr )
-  , _life_ptr( nullptr )
-  , _size_ptr( nullptr )
-  , _position_ptr( nullptr )
-  , _color_ptr( nullptr )
-  , _velocityModule_ptr( nullptr )
-  , _velocity_ptr( nullptr )
-  , _accelerationModule_ptr( nullptr )
-  , _acceleration_ptr( nullptr )
-  , _alive_ptr( nullptr )
+  , _indexIterator( )
+  , _current( )
   { }
 
   Particles::base_const_iterator::base_const_iterator( const Particles::base_const_iterator& other )
@@ -195,16 +241,8 @@ namespace prefr
   , _vectorRef( other._vectorRef )
   , _indexPosition( other._indexPosition )
   , _particleIndices( other._particleIndices )
-  , _id_ptr( other._id_ptr )
-  , _life_ptr( other._life_ptr )
-  , _size_ptr( other._size_ptr )
-  , _position_ptr( other._position_ptr )
-  , _color_ptr( other._color_ptr )
-  , _velocityModule_ptr( other._velocityModule_ptr )
-  , _velocity_ptr( other._velocity_ptr )
-  , _accelerationModule_ptr( other._accelerationModule_ptr )
-  , _acceleration_ptr( other._acceleration_ptr )
-  , _alive_ptr( other._alive_ptr )
+  , _indexIterator( other._indexIterator )
+  , _current( other._current )
   { }
 
   Particles::base_const_iterator::~base_const_iterator( void )
@@ -212,26 +250,8 @@ namespace prefr
 
   void Particles::base_const_iterator::set( unsigned int index_ )
   {
-    _id_ptr =
-        std::get< ( unsigned int ) prefr::ID >( _vectorRef ) + index_;
-    _life_ptr =
-        std::get< ( unsigned int ) prefr::LIFE >( _vectorRef ) + index_;
-    _size_ptr =
-        std::get< ( unsigned int ) prefr::SIZE >( _vectorRef ) + index_;
-    _position_ptr =
-        std::get< ( unsigned int ) prefr::POSITION >( _vectorRef ) + index_;
-    _color_ptr =
-        std::get< ( unsigned int ) prefr::COLOR >( _vectorRef ) + index_;
-    _velocityModule_ptr =
-        std::get< ( unsigned int ) prefr::VELOCITY_MODULE >( _vectorRef ) + index_;
-    _velocity_ptr =
-        std::get< ( unsigned int ) prefr::VELOCITY >( _vectorRef ) + index_;
-    _accelerationModule_ptr =
-        std::get< ( unsigned int ) prefr::ACCELERATION_MODULE >( _vectorRef ) + index_;
-    _acceleration_ptr =
-        std::get< ( unsigned int ) prefr::ACCELERATION >( _vectorRef ) + index_;
-    _alive_ptr =
-        std::get< ( unsigned int ) prefr::PARTICLE_ALIVE >( _vectorRef ) + index_;
+    OffsetAttribute offsetAttribute{ ( int ) index_ };
+    forEachAttribute( _vectorRef, _current, offsetAttribute );
 
     _position = index_;
   }
@@ -242,23 +262,17 @@ namespace prefr
 
     if( _particleIndices && _indexPosition < _size )
     {
+      if( inc == 1 )
+        ++_indexIterator;
+      else
+        _indexIterator = _particleIndices->at( _indexPosition );
 
-      unsigned int index = (*_particleIndices)[ _indexPosition ];
-
-      set( index );
+      set( *_indexIterator );
     }
     else
     {
-      _id_ptr += inc;
-      _life_ptr += inc;
-      _size_ptr += inc;
-      _position_ptr += inc;
-      _color_ptr += inc;
-      _velocityModule_ptr += inc;
-      _velocity_ptr += inc;
-      _accelerationModule_ptr += inc;
-      _acceleration_ptr += inc;
-      _alive_ptr += inc;
+      AdvanceAttribute advanceAttribute{ inc };
+      forEachAttribute( _current, advanceAttribute );
 
       _position += inc;
     }
@@ -270,23 +284,17 @@ namespace prefr
 
     if( _particleIndices && _indexPosition < _particleIndices->size( ))
     {
+      if( dec == 1 )
+        --_indexIterator;
+      else
+        _indexIterator = _particleIndices->at( _indexPosition );
 
-      unsigned int index = (*_particleIndices)[ _indexPosition ];
-
-      set( index );
+      set( *_indexIterator );
     }
     else
     {
-      _id_ptr -= dec;
-      _life_ptr -= dec;
-      _size_ptr -= dec;
-      _position_ptr -= dec;
-      _color_ptr -= dec;
-      _velocityModule_ptr -= dec;
-      _velocity_ptr -= dec;
-      _accelerationModule_ptr -= dec;
-      _acceleration_ptr -= dec;
-      _alive_ptr -= dec;
+      AdvanceAttribute advanceAttribute{ -dec };
+      forEachAttribute( _current, advanceAttribute );
 
       _position -= dec;
     }
@@ -321,16 +329,7 @@ namespace prefr
 
   TParticle Particles::base_const_iterator::currentValues( void )
   {
-    return std::make_tuple( _id_ptr,
-                            _life_ptr,
-                            _size_ptr,
-                            _position_ptr,
-                            _color_ptr,
-                            _velocityModule_ptr,
-                            _velocity_ptr,
-                            _accelerationModule_ptr,
-                            _acceleration_ptr,
-                            _alive_ptr);
+    return _current;
   }
 
   void Particles::base_const_iterator::print( std::ostream& stream ) const
@@ -381,7 +380,6 @@ namespace prefr
 
   ParticleCollection::ParticleCollection( const ParticleCollection& other )
   : _particleIndices( other._particleIndices )
-  , _indices( other._indices )
   , _vectorReferences( other._vectorReferences )
   , _size( other._particleIndices.size( ))
   , _data( other._data )
@@ -405,12 +403,8 @@ namespace prefr
     if( end_ < begin_ )
       std::swap( begin_, end_ );
 
-    for( unsigned int i = begin_; i < end_; i++ )
-    {
-      _particleIndices.push_back( i );
-    }
+    _particleIndices.insert( begin_, end_ );
 
-    _indices = _particleIndices.vector( );
     _size = _particleIndices.size( );
   }
 
@@ -424,19 +418,14 @@ namespace prefr
     unsigned int begin = begin_ - beginIt;
     unsigned int end = end_ - beginIt;
 
-    for( unsigned int i = begin; i < end; i++ )
-    {
-      _particleIndices.push_back( i );
-    }
+    _particleIndices.insert( begin, end );
 
-    _indices = _particleIndices.vector( );
     _size = _particleIndices.size( );
   }
 
   ParticleCollection::ParticleCollection( const Particles& data_,
                                           const ParticleSet& indices_ )
   : _particleIndices( indices_ )
-  , _indices( _particleIndices.vector( ))
   , _vectorReferences( data_.vectorReferences( ))
   , _size( _particleIndices.size( ))
   , _data( & data_ )
@@ -445,22 +434,20 @@ namespace prefr
   ParticleCollection::ParticleCollection( const Particles& data_,
                                           const ParticleIndices& indices_ )
   : _particleIndices( indices_ )
-  , _indices( indices_ )
   , _vectorReferences( data_.vectorReferences( ))
   , _size( _particleIndices.size( ))
   , _data( & data_ )
   { }
 
 
-  const ParticleIndices& ParticleCollection::indices( void ) const
+  const ParticleSet& ParticleCollection::indices( void ) const
   {
-    return _indices;
+    return _particleIndices;
   }
 
   void ParticleCollection::indices( const ParticleSet& newIndices )
   {
     _particleIndices = newIndices;
-    _indices = _particleIndices.vector( );
     _size = _particleIndices.size( );
   }
 
@@ -468,10 +455,19 @@ namespace prefr
   void ParticleCollection::indices( const ParticleIndices& newIndices )
   {
     _particleIndices = newIndices;
-    _indices = newIndices;
     _size = _particleIndices.size( );
   }
 
+  IndexSpans ParticleCollection::spans( unsigned int maxLength ) const
+  {
+    // Collections without indices cover the whole set of particles.
+    if( !_particleIndices.size( ))
+      return _size ? IndexSpans( 1, IndexSpan( 0, _size )) : IndexSpans( );
+
+    return maxLength > 0 ? _particleIndices.spans( maxLength ) :
+                           _particleIndices.spans( );
+  }
+
   size_t ParticleCollection::size( void ) const
   {
     return _size;
@@ -485,7 +481,7 @@ namespace prefr
   Particles::iterator ParticleCollection::find( unsigned int particleId )
   {
     if( _particleIndices.hasElement( particleId ))
-      return _createIterator( particleId );
+      return _createIterator( _particleIndices.rank( particleId ));
 
     return _createIterator( _size, true );
   }
@@ -537,6 +533,13 @@ namespace prefr
     return _createIterator( i, !_particleIndices.size( ) );
   }
 
+  ParticleRef ParticleCollection::ref( unsigned int index_ ) const
+  {
+    assert( _data && index_ < _data->numParticles( ));
+
+    return ParticleRef( const_cast< Particles* >( _data ), index_ );
+  }
+
 
   Particles::iterator
   ParticleCollection::_createIterator( unsigned int index_, bool absolute ) const
@@ -553,24 +556,24 @@ namespace prefr
     {
       if( index_ < _particleIndices.size( ))
       {
-        result._particleIndices = &_indices;
+        result._particleIndices = &_particleIndices;
         result._size = _particleIndices.size( );
 
         result._indexPosition = index_;
+        result._indexIterator = _particleIndices.at( index_ );
 
-        unsigned int index = _indices[ index_ ];
-
-        result.set( index );
+        result.set( *result._indexIterator );
 
       }
       else if( _particleIndices.size( ) && index_ == _particleIndices.size( ) )
       {
-       unsigned int index = _indices.back( ) + 1;
-       result._particleIndices = &_indices;
+       unsigned int index = _particleIndices.back( ) + 1;
+       result._particleIndices = &_particleIndices;
        result._size = _particleIndices.size( );
        result._position = index;
 
        result._indexPosition = index_;
+       result._indexIterator = _particleIndices.end( );
       }
     }
     else
@@ -586,7 +589,6 @@ namespace prefr
   void ParticleCollection::addIndex( unsigned int idx )
   {
     _particleIndices.append( idx );
-    _indices = _particleIndices.vector( );
 
     _size = _particleIndices.size( );
   }
@@ -594,7 +596,6 @@ namespace prefr
   void ParticleCollection::addIndices( const ParticleSet& idxVector )
   {
     _particleIndices.insert( idxVector );
-    _indices = _particleIndices.vector( );
 
     _size = _particleIndices.size( );
   }
@@ -602,7 +603,6 @@ namespace prefr
   void ParticleCollection::removeIndex( unsigned int idx )
   {
     _particleIndices.remove( idx );
-    _indices = _particleIndices.vector( );
 
     _size = _particleIndices.size( );
   }
@@ -610,7 +610,6 @@ namespace prefr
   void ParticleCollection::removeIndices( const ParticleSet& idxVector )
   {
     _particleIndices.remove( idxVector );
-    _indices = _particleIndices.vector( );
 
     _size = _particleIndices.size( );
   }
@@ -27,85 +27,77 @@
 
 #include "../utils/types.h"
 #include "../utils/VectorizedSet.hpp"
+#include "../utils/RangeSet.hpp"
+
+#include "ParticleAttributes.h"
 
 #include <vector>
 #include <tuple>
+#include <type_traits>
 #include <memory>
 #include <iostream>
 #include <set>
 
 #define STRINGIZE( cad ) #cad
 
-#define PREFR_ATRIB( name, type ) \
-  protected: \
-    std::vector< type > _##name##Vector; /*! Vector storing name attribute. */ \
-  public: \
-    type& p##name( unsigned int i ){ return _##name##Vector[ i ]; } \
-    void p##name( unsigned int i, const type& value ) \
-      { _##name##Vector[ i ] = value; }
-
-#define PREFR_ATRIB_BOOL( name ) \
-  protected: \
-    std::vector< char > _##name##Vector; \
+#define PREFR_GET_ATRIB( name, tag, T ) \
   public: \
-    bool p##name( unsigned int i ){ return _##name##Vector[ i ]; } \
-    void p##name( unsigned int i, const bool& value ) \
-      { _##name##Vector[ i ] = value; }
+    template< typename S = ParticleAttributes > \
+    typename std::enable_if< S::template has< attrib::tag >::value, T >::type \
+    name( void ) const { return attribute< attrib::tag >( ); }
 
-#define PREFR_CONST_IT_ATRIB( name, type ) \
-  protected: \
-    type* _##name##_ptr; \
+#define PREFR_SET_ATRIB( name, tag, T ) \
   public: \
-    type name( void ) const { return *_##name##_ptr; }
-//    type name( void ) const { std::cout << "attrib " << STRINGIZE( name ) << " " << _##name##_ptr << std::endl; return *_##name##_ptr; }
-
-#define PREFR_CONST_IT_ATRIB_BOOL( name ) \
-  protected: \
-    char* _##name##_ptr; \
-  public: \
-    bool name( void ) const { return *_##name##_ptr; }
-
-
-#define PREFR_IT_ATRIB( name, type ) \
-  public: \
-    void set_##name( const type& value ){ *_##name##_ptr = value; }
+    template< typename S = ParticleAttributes > \
+    typename std::enable_if< S::template has< attrib::tag >::value >::type \
+    set_##name( const T& value ){ set_attribute< attrib::tag >( value ); }
 
 
 namespace prefr
 {
   class Particles;
+  class ParticleRef;
   class ParticleCollection;
 
   typedef ParticleCollection ParticleRange;
-  typedef prefr::VectorizedSet< unsigned int > ParticleSet;
+  typedef prefr::RangeSet ParticleSet;
   typedef std::vector< unsigned int > ParticleIndices;
 
 //  typedef utils::ElementCollection< prefr::Particles > ParticleRange;
 //  typedef utils::ElementCollection< prefr::Particles > ParticleCollection;
 
-  typedef std::tuple< unsigned int*,
-                      float*,
-                      float*,
-                      TVect3*,
-                      TVect4*,
-                      float*,
-                      TVect3*,
-                      float*,
-                      TVect3*,
-                      char*> TParticle;
-
-  enum TParticleAttribEnum
+  /*! Pointers to every attribute of ParticleAttributes. */
+  typedef ParticleAttributes::Pointers TParticle;
+
+  /*! \struct ParticleSpan
+   *
+   * \brief Contiguous range of particles exposed as raw attribute arrays.
+   *
+   * Attribute pointers reference the first particle of the range, so the
+   * i-th particle of the span is accessed as attribute< attrib::Life >( )[ i ]
+   * and so on, for i in [ 0, length ). Vector attributes are split into one
+   * array per component, available through SplitPointer::component. Used by
+   * batch updaters to process particles in plain loops the compiler can
+   * vectorize.
+   *
+   * @see Particles::span
+   * @see Updater::updateRange
+   */
+  struct ParticleSpan
   {
-    ID = 0,
-    LIFE,
-    SIZE,
-    POSITION,
-    COLOR,
-    VELOCITY_MODULE,
-    VELOCITY,
-    ACCELERATION_MODULE,
-    ACCELERATION,
-    PARTICLE_ALIVE
+    Particles* data;
+
+    unsigned int begin;
+    unsigned int length;
+
+    TParticle attributes;
+
+    template< typename Tag >
+    typename AttributeTraits< typename Tag::type >::pointer
+    attribute( void ) const
+    {
+      return std::get< ParticleAttributes::index< Tag >::value >( attributes );
+    }
   };
 
   /*! \class Particles
@@ -118,6 +110,11 @@ namespace prefr
    * values. Iterators generated from this class allow to iterate through the
    * whole set of particles in order to alter their properties' values.
    *
+   * Each attribute is stored in its own array aligned to attributeAlignment
+   * bytes, and vector attributes are split into one array per component
+   * (x[], y[], z[]...). Allocations go through AlignedAllocator, whose
+   * allocation functions can be replaced with prefr::alignedAllocation.
+   * Only the attributes listed in ParticleAttributes are stored.
    *
    * @see ParticleSystem
    * @see Particles::iterator
@@ -275,6 +272,41 @@ namespace prefr
      */
     const_iterator operator[]( unsigned int i ) const;
 
+    /*! \brief Returns the attribute arrays of the given range of particles.
+     *
+     * Returns the attribute arrays of the particles contained in
+     * [ begin, end ).
+     *
+     * @param begin First particle of the range.
+     * @param end Position after the last particle of the range.
+     * @return ParticleSpan referencing the given range.
+     */
+    ParticleSpan span( unsigned int begin, unsigned int end );
+
+    /*! \brief Returns a handle to the given particle.
+     *
+     * Returns a handle to the particle stored at the given position. Handles
+     * are cheaper than iterators to create and copy, so prefer them for
+     * index-driven loops.
+     *
+     * @param i Position of the particle.
+     * @return ParticleRef referencing the given particle.
+     */
+    ParticleRef ref( unsigned int i );
+
+    /*! \brief Returns the array storing the given attribute.
+     *
+     * Returns the array storing the given attribute, which must be part of
+     * ParticleAttributes.
+     *
+     * @return Array storing the given attribute.
+     */
+    template< typename Tag >
+    typename AttributeTraits< typename Tag::type >::vector& attribute( void )
+    {
+      return std::get< ParticleAttributes::index< Tag >::value >( _attributes );
+    }
+
   protected:
 
     iterator _createIterator( unsigned int i ) const;
@@ -283,23 +315,82 @@ namespace prefr
 
     void initVectorReferences( void );
 
-    PREFR_ATRIB( id, unsigned int )
-    PREFR_ATRIB( life, float )
-    PREFR_ATRIB( size, float )
-    PREFR_ATRIB( position, glm::vec3 )
-    PREFR_ATRIB( color, glm::vec4 )
-    PREFR_ATRIB( velocityModule, float )
-    PREFR_ATRIB( velocity, glm::vec3 )
-    PREFR_ATRIB( accelerationModule, float )
-    PREFR_ATRIB( acceleration, glm::vec3 )
-
-    PREFR_ATRIB_BOOL( alive )
+    /*! Arrays storing each attribute of ParticleAttributes. */
+    ParticleAttributes::Vectors _attributes;
 
     unsigned int _size;
 
     TParticle _vectorReferences;
   };
 
+  /*! \class ParticleRef
+   *
+   * \brief Handle to a single particle, made of the particles storage and
+   * the particle position.
+   *
+   * Attributes are looked up from the position on each access instead of
+   * keeping one pointer per attribute, so handles are as cheap to create and
+   * copy as a pointer and an index. Provides the same attribute accessors
+   * than particle iterators.
+   *
+   * @see Particles::ref
+   */
+  class ParticleRef
+  {
+  public:
+
+    ParticleRef( Particles* data, unsigned int index_ )
+    : _data( data )
+    , _index( index_ )
+    { }
+
+    /*! \brief Returns the position of the particle. */
+    unsigned int index( void ) const
+    {
+      return _index;
+    }
+
+    template< typename Tag >
+    typename AttributeTraits< typename Tag::type >::reference
+    attribute( void ) const
+    {
+      return _data->attribute< Tag >( )[ _index ];
+    }
+
+    template< typename Tag >
+    void set_attribute( const typename Tag::type& value )
+    {
+      _data->attribute< Tag >( )[ _index ] = value;
+    }
+
+    PREFR_GET_ATRIB( id, Id, unsigned int )
+    PREFR_GET_ATRIB( life, Life, float )
+    PREFR_GET_ATRIB( size, Size, float )
+    PREFR_GET_ATRIB( position, Position, glm::vec3 )
+    PREFR_GET_ATRIB( color, Color, glm::vec4 )
+    PREFR_GET_ATRIB( velocityModule, VelocityModule, float )
+    PREFR_GET_ATRIB( velocity, Velocity, glm::vec3 )
+    PREFR_GET_ATRIB( accelerationModule, AccelerationModule, float )
+    PREFR_GET_ATRIB( acceleration, Acceleration, glm::vec3 )
+    PREFR_GET_ATRIB( alive, Alive, bool )
+
+    PREFR_SET_ATRIB( id, Id, unsigned int )
+    PREFR_SET_ATRIB( life, Life, float )
+    PREFR_SET_ATRIB( size, Size, float )
+    PREFR_SET_ATRIB( position, Position, glm::vec3 )
+    PREFR_SET_ATRIB( color, Color, glm::vec4 )
+    PREFR_SET_ATRIB( velocityModule, VelocityModule, float )
+    PREFR_SET_ATRIB( velocity, Velocity, glm::vec3 )
+    PREFR_SET_ATRIB( accelerationModule, AccelerationModule, float )
+    PREFR_SET_ATRIB( acceleration, Acceleration, glm::vec3 )
+    PREFR_SET_ATRIB( alive, Alive, bool )
+
+  protected:
+
+    Particles* _data;
+    unsigned int _index;
+  };
+
 
   class ParticleCollection
   {
@@ -310,6 +401,7 @@ namespace prefr
     friend class Particles::const_iterator;
     friend class Particles;
     friend class ParticleSystem;
+    friend class Source;
 
     ParticleCollection( void );
     ParticleCollection( const ParticleCollection& other );
@@ -317,10 +409,21 @@ namespace prefr
     ParticleCollection( const Particles& data, const ParticleSet& indices_ );
     ParticleCollection( const Particles& data, const ParticleIndices& indices_ );
 
-    const ParticleIndices& indices( void ) const;
+    const ParticleSet& indices( void ) const;
     void indices( const ParticleSet& newIndices );
     void indices( const ParticleIndices& newIndices );
 
+    /*! \brief Returns the collection indices as spans of consecutive indices.
+     *
+     * Returns the collection indices as spans of consecutive indices, in
+     * ascending order. Spans longer than maxLength are split, which is
+     * useful for balancing parallel loops.
+     *
+     * @param maxLength Maximum number of indices per span, 0 for no limit.
+     * @return Spans of consecutive indices.
+     */
+    IndexSpans spans( unsigned int maxLength = 0 ) const;
+
     size_t size( void ) const;
     bool empty( void ) const;
 
@@ -372,6 +475,17 @@ namespace prefr
      */
     Particles::const_iterator operator[]( unsigned int i ) const;
 
+    /*! \brief Returns a handle to the given particle.
+     *
+     * Returns a handle to the particle stored at the given position of the
+     * referenced Particles object, such as the ids stored by the collection
+     * indices.
+     *
+     * @param index_ Position of the particle within the Particles object.
+     * @return ParticleRef referencing the given particle.
+     */
+    ParticleRef ref( unsigned int index_ ) const;
+
     void addIndex( unsigned int idx );
     void addIndices( const ParticleSet& idxVector );
 
@@ -396,7 +510,6 @@ namespace prefr
     Particles::iterator _createIterator( unsigned int index = 0, bool absolute = false ) const;
 
     ParticleSet _particleIndices;
-    ParticleIndices _indices;
     TParticle _vectorReferences;
 
     unsigned int _size;
@@ -433,6 +546,12 @@ namespace prefr
 
     TParticle currentValues( void );
 
+    template< typename Tag >
+    typename Tag::type attribute( void ) const
+    {
+      return *std::get< ParticleAttributes::index< Tag >::value >( _current );
+    }
+
     unsigned int _position;
     unsigned int _size;
 
@@ -440,18 +559,22 @@ namespace prefr
     TParticle _vectorRef;
 
     unsigned int _indexPosition;
-    const ParticleIndices* _particleIndices;
-
-    PREFR_CONST_IT_ATRIB( id, unsigned int )
-    PREFR_CONST_IT_ATRIB( life, float )
-    PREFR_CONST_IT_ATRIB( size, float )
-    PREFR_CONST_IT_ATRIB( position, glm::vec3 )
-    PREFR_CONST_IT_ATRIB( color, glm::vec4 )
-    PREFR_CONST_IT_ATRIB( velocityModule, float )
-    PREFR_CONST_IT_ATRIB( velocity, glm::vec3 )
-    PREFR_CONST_IT_ATRIB( accelerationModule, float )
-    PREFR_CONST_IT_ATRIB( acceleration, glm::vec3 )
-    PREFR_CONST_IT_ATRIB_BOOL( alive )
+    const ParticleSet* _particleIndices;
+    ParticleSet::const_iterator _indexIterator;
+
+    /*! Pointers to the attributes of the current particle. */
+    TParticle _current;
+
+    PREFR_GET_ATRIB( id, Id, unsigned int )
+    PREFR_GET_ATRIB( life, Life, float )
+    PREFR_GET_ATRIB( size, Size, float )
+    PREFR_GET_ATRIB( position, Position, glm::vec3 )
+    PREFR_GET_ATRIB( color, Color, glm::vec4 )
+    PREFR_GET_ATRIB( velocityModule, VelocityModule, float )
+    PREFR_GET_ATRIB( velocity, Velocity, glm::vec3 )
+    PREFR_GET_ATRIB( accelerationModule, AccelerationModule, float )
+    PREFR_GET_ATRIB( acceleration, Acceleration, glm::vec3 )
+    PREFR_GET_ATRIB( alive, Alive, bool )
   };
 
   class Particles::base_iterator : public Particles::base_const_iterator
@@ -466,16 +589,22 @@ namespace prefr
 
     base_iterator( void );
 
-    PREFR_IT_ATRIB( id, unsigned int )
-    PREFR_IT_ATRIB( life, float )
-    PREFR_IT_ATRIB( size, float )
-    PREFR_IT_ATRIB( position, glm::vec3 )
-    PREFR_IT_ATRIB( color, glm::vec4 )
-    PREFR_IT_ATRIB( velocityModule, float )
-    PREFR_IT_ATRIB( velocity, glm::vec3 )
-    PREFR_IT_ATRIB( accelerationModule, float )
-    PREFR_IT_ATRIB( acceleration, glm::vec3 )
-    PREFR_IT_ATRIB( alive, bool )
+    template< typename Tag >
+    void set_attribute( const typename Tag::type& value )
+    {
+      *std::get< ParticleAttributes::index< Tag >::value >( _current ) = value;
+    }
+
+    PREFR_SET_ATRIB( id, Id, unsigned int )
+    PREFR_SET_ATRIB( life, Life, float )
+    PREFR_SET_ATRIB( size, Size, float )
+    PREFR_SET_ATRIB( position, Position, glm::vec3 )
+    PREFR_SET_ATRIB( color, Color, glm::vec4 )
+    PREFR_SET_ATRIB( velocityModule, VelocityModule, float )
+    PREFR_SET_ATRIB( velocity, Velocity, glm::vec3 )
+    PREFR_SET_ATRIB( accelerationModule, AccelerationModule, float )
+    PREFR_SET_ATRIB( acceleration, Acceleration, glm::vec3 )
+    PREFR_SET_ATRIB( alive, Alive, bool )
 
   };
 
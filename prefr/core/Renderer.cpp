@@ -22,12 +22,25 @@
 
 #include "Renderer.h"
 
+#include <algorithm>
+
 namespace prefr
 {
+  /*! Gap, in particles, below which changed spans are merged, as uploading
+   * a few unchanged particles is cheaper than another upload call. */
+  static const unsigned int changedSpanGap = 256;
+
+  /*! Number of changed spans that triggers merging them. */
+  static const size_t maxChangedSpans = 4096;
 
   Renderer::Renderer( )
   : _distances( nullptr )
   , _renderConfig( nullptr )
+  , _models( nullptr )
+  , _particleModels( nullptr )
+  , _evaluatesCurves( false )
+  , _particleData( nullptr )
+  , _tracksChanges( false )
   , _parallel( false )
   { }
 
@@ -37,6 +50,59 @@ namespace prefr
       delete( _renderConfig );
   }
 
+  void Renderer::_particlesChanged( unsigned int begin, unsigned int end )
+  {
+    if( begin >= end )
+      return;
+
+    // Spans are mostly reported in ascending order, so most of them extend
+    // the last one.
+    if( !_changedSpans.empty( ))
+    {
+      IndexSpan& last = _changedSpans.back( );
+      if( begin >= last.begin && begin <= last.end + changedSpanGap )
+      {
+        last.end = std::max( last.end, end );
+        return;
+      }
+    }
+
+    _changedSpans.push_back( IndexSpan( begin, end ));
+
+    if( _changedSpans.size( ) > maxChangedSpans )
+      _mergeChangedSpans( );
+  }
+
+  void Renderer::_mergeChangedSpans( void )
+  {
+    std::sort( _changedSpans.begin( ), _changedSpans.end( ),
+               []( const IndexSpan& a, const IndexSpan& b )
+               { return a.begin < b.begin; });
+
+    size_t count = 0;
+    for( auto const& span : _changedSpans )
+    {
+      if( count > 0 &&
+          span.begin <= _changedSpans[ count - 1 ].end + changedSpanGap )
+      {
+        IndexSpan& last = _changedSpans[ count - 1 ];
+        last.end = std::max( last.end, span.end );
+      }
+      else
+        _changedSpans[ count++ ] = span;
+    }
+
+    _changedSpans.resize( count );
+
+    // Spans scattered all over the particles are uploaded as a whole.
+    if( _changedSpans.size( ) > maxChangedSpans / 2 )
+    {
+      IndexSpan bounds( _changedSpans.front( ).begin,
+                        _changedSpans.back( ).end );
+      _changedSpans.assign( 1, bounds );
+    }
+  }
+
   void Renderer::particles( const ParticleRange& particles_ )
   {
     _particles = particles_;
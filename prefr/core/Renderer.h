@@ -29,6 +29,7 @@
 #include "Particles.h"
 
 #include "DistanceArray.hpp"
+#include "Model.h"
 #include "RenderConfig.h"
 
 namespace prefr
@@ -58,11 +59,29 @@ namespace prefr
 
     virtual void _init( void ) = 0;
 
+    void _particlesChanged( unsigned int begin, unsigned int end );
+    void _mergeChangedSpans( void );
+
     ParticleCollection _particles;
 
     DistanceArray* _distances;
     RenderConfig* _renderConfig;
 
+    /*! Models of the particle system, and model of each particle. */
+    const ModelsArray* _models;
+    const std::vector< Model* >* _particleModels;
+
+    /*! True if the renderer evaluates color and size curves from the life
+     * of particles, so updaters do not need to. */
+    bool _evaluatesCurves;
+
+    /*! Particle arrays in storage order, and spans of them updated since
+     * the renderer last uploaded them. Spans are only reported to renderers
+     * tracking changes. */
+    Particles* _particleData;
+    IndexSpans _changedSpans;
+    bool _tracksChanges;
+
     bool _parallel;
 
   };
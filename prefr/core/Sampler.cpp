@@ -23,42 +23,97 @@
 #include "Sampler.h"
 
 #include "../utils/types.h"
+#include "../utils/SIMD.h"
+
+#include <algorithm>
 
 namespace prefr
 {
-  static float invRandMax = 1.0f / RAND_MAX;
-  static float pi2 = 2.0f * float( M_PI );
+  // Cosine of the half aperture of a cone given its aperture in degrees.
+  static float coneCosine( float apertureDegrees )
+  {
+    float aperture = glm::clamp( apertureDegrees, 0.0f, 360.0f );
+    return cosf( aperture * 0.5f * float( M_PI ) / 180.0f );
+  }
 
-  glm::vec3 randomSphericalDirection( float thetaAngle = pi2 )
+  glm::vec3 randomSphericalDirection( RandomStream& random,
+                                      float cosAngle = -1.0f )
   {
-    float theta, phi, vxz;
+    float u = random.uniform( );
+    float v = random.uniform( );
 
-    theta = glm::clamp( rand( ) * invRandMax, 0.0f, 1.0f ) * thetaAngle;
-    phi = glm::clamp( rand( ) * invRandMax, 0.0f, 1.0f ) * pi2;
-    vxz = sinf( theta );
+    float x, y, z;
+    float* direction[ 3 ] = { &x, &y, &z };
+    simd::coneDirections( &u, &v, direction, 1, cosAngle );
 
-    return glm::vec3( cosf( phi ) * vxz, cosf( theta ), sinf( phi ) * vxz );
+    return glm::vec3( x, y, z );
+  }
+
+  void randomSphericalDirections( const SampledBatch& batch,
+                                  float cosAngle = -1.0f )
+  {
+    // Random values are generated in place, into x and z.
+    float* random[ 2 ] = { batch.direction[ 0 ], batch.direction[ 2 ]};
+    batch.random.uniform( batch.indices, random, 2, batch.count,
+                          RandomContext::sampleStream );
+
+    simd::coneDirections( random[ 0 ], random[ 1 ], batch.direction,
+                          batch.count, cosAngle );
+  }
+
+  void Sampler::sampleBatch( const Source& source,
+                             const SampledBatch& batch ) const
+  {
+    SampledValues values;
+
+    for( unsigned int i = 0; i < batch.count; ++i )
+    {
+      values.index = batch.indices[ i ];
+      values.random = batch.random.stream( values.index,
+                                           RandomContext::sampleStream );
+
+      sample( source, &values );
+
+      for( unsigned int c = 0; c < 3; ++c )
+      {
+        batch.position[ c ][ i ] = values.position[ c ];
+        batch.direction[ c ][ i ] = values.direction[ c ];
+      }
+    }
   }
 
   void PointSampler::sample( const Source& source,
                              SampledValues* values ) const
   {
     values->position = source.position( );
-    values->direction = randomSphericalDirection( );
+    values->direction = randomSphericalDirection( values->random );
     // Identity matrix
     values->rotation = glm::mat4( 1.0f );
   }
 
+  void PointSampler::sampleBatch( const Source& source,
+                                  const SampledBatch& batch ) const
+  {
+    randomSphericalDirections( batch );
+
+    glm::vec3 position = source.position( );
+    for( unsigned int c = 0; c < 3; ++c )
+      std::fill( batch.position[ c ], batch.position[ c ] + batch.count,
+                 position[ c ]);
+  }
+
   SphereSampler::SphereSampler( float radius_, float angleTheta_ )
   : Sampler( )
   , _radius( radius_ )
   , _angleTheta( angleTheta_ )
+  , _cosAngle( coneCosine( angleTheta_ ))
   { }
 
   void SphereSampler::sample( const Source& source,
                               SampledValues* values ) const
   {
-    values->direction = randomSphericalDirection( );
+    values->direction = randomSphericalDirection( values->random,
+                                                  _cosAngle );
 
     values->position = source.position( ) + values->direction * _radius;
 
@@ -66,9 +121,26 @@ namespace prefr
     values->rotation = glm::mat4( 1.0f );
   }
 
+  void SphereSampler::sampleBatch( const Source& source,
+                                   const SampledBatch& batch ) const
+  {
+    randomSphericalDirections( batch, _cosAngle );
+
+    glm::vec3 position = source.position( );
+    for( unsigned int c = 0; c < 3; ++c )
+    {
+      const float* direction = batch.direction[ c ];
+      float* result = batch.position[ c ];
+
+      for( unsigned int i = 0; i < batch.count; ++i )
+        result[ i ] = position[ c ] + direction[ i ] * _radius;
+    }
+  }
+
   void SphereSampler::angleTheta( float angle )
   {
     _angleTheta = angle;
+    _cosAngle = coneCosine( angle );
   }
 
   float SphereSampler::angleTheta( void ) const
@@ -76,6 +148,11 @@ namespace prefr
     return _angleTheta;
   }
 
+  float SphereSampler::cosAngle( void ) const
+  {
+    return _cosAngle;
+  }
+
   void SphereSampler::radius( float radiusDegrees )
   {
     _radius = radiusDegrees;
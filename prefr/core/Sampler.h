@@ -29,6 +29,7 @@ namespace prefr
 {
   class Source;
   class SampledValues;
+  class SampledBatch;
 
   class Sampler
   {
@@ -44,6 +45,22 @@ namespace prefr
     virtual void sample( const Source& source,
                          SampledValues* values ) const = 0;
 
+    /*! \brief Samples the position and direction of a batch of particles.
+     *
+     * Stores in the batch arrays the position and direction of each
+     * particle, as Sampler#sample would do for each one of them. Rotation
+     * is not generated.
+     *
+     * Default implementation calls Sampler#sample for each particle.
+     * Re-implement to generate the whole batch at once.
+     *
+     * @param source Source emitting the particles.
+     * @param batch Particles to sample and output arrays.
+     */
+    PREFR_API
+    virtual void sampleBatch( const Source& source,
+                              const SampledBatch& batch ) const;
+
   };
 
 
@@ -60,6 +77,10 @@ namespace prefr
     PREFR_API
     virtual void sample( const Source& source,
                          SampledValues* values ) const;
+
+    PREFR_API
+    virtual void sampleBatch( const Source& source,
+                              const SampledBatch& batch ) const;
   };
 
   class SphereSampler : public Sampler
@@ -77,11 +98,28 @@ namespace prefr
                          SampledValues* values ) const;
 
     PREFR_API
+    virtual void sampleBatch( const Source& source,
+                              const SampledBatch& batch ) const;
+
+    /*! \brief Sets the aperture in degrees of the emission cone.
+     *
+     * Directions are sampled uniformly within a cone around the +Y axis
+     * with the given aperture. 360 degrees covers the whole sphere.
+     *
+     * @param angle Cone aperture in degrees.
+     */
+    PREFR_API
     void angleTheta( float angle );
 
     PREFR_API
     float angleTheta( void ) const;
 
+    /*! \brief Returns the cosine of the half aperture of the emission
+     * cone, computed when the aperture is set.
+     */
+    PREFR_API
+    float cosAngle( void ) const;
+
     PREFR_API
     void radius( float radiusDegrees );
 
@@ -93,6 +131,9 @@ namespace prefr
     float _radius;
     float _angleTheta;
 
+    /*! Cosine of the half aperture, so sampling takes no trigonometry. */
+    float _cosAngle;
+
   };
 
 }
@@ -22,6 +22,12 @@
 
 #include "Sorter.h"
 
+#include "../utils/RadixSort.h"
+#include "../utils/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+
 #ifdef PREFR_USE_OPENMP
 #ifdef _WINDOWS
 #include <ppl.h>
@@ -32,12 +38,40 @@
 
 namespace prefr
 {
+  /*! Maximum number of particles written by each parallel distance task. */
+  static const unsigned int distanceSpanLength = 4096;
+
+  /*! Maximum fraction (1/n) of unsorted distances merged by incremental
+   * sorting before falling back to a full sort. */
+  static const unsigned int incrementalUnsorted = 4;
+
+  /*! Maximum number of full sorts done before trying incremental sorting
+   * again. */
+  static const unsigned int incrementalMaxBackoff = 32;
 
   Sorter::Sorter( )
   : _sources( nullptr )
   , _distances( nullptr )
   , _aliveParticles( 0 )
   , _parallel( false )
+  , _compactAlive( false )
+  , _algorithm( Radix )
+  , _incremental( false )
+  , _particlesChanged( true )
+  , _sorted( false )
+  , _skipSort( false )
+  , _lastCameraPosition( 0.0f )
+  , _lastRenderDeadParticles( false )
+  , _sortStamp( 0 )
+  , _incrementalBackoff( 0 )
+  , _incrementalWait( 0 )
+  , _distanceKey( Distance )
+  , _depthKey( false )
+  , _keyAxis( 0.0f )
+  , _lastKeyAxis( 0.0f )
+  , _keysCamera( 0.0f )
+  , _keysAxis( 0.0f )
+  , _keysValid( false )
   {}
 
   Sorter::~Sorter()
@@ -47,34 +81,37 @@ namespace prefr
       delete( _distances );
   }
 
+  bool Sorter::_batched( void ) const
+  {
+    return true;
+  }
+
   void Sorter::initDistanceArray( ICamera* camera )
   {
     _distances = new DistanceArray( _particles.size( ), camera );
+
+    _previousIds.clear( );
+    _incrementalBackoff = 0;
+    _incrementalWait = 0;
+    _sorted = false;
   }
 
   void Sorter::sort(SortOrder /*order*/)
   {
-    TDistUnitContainer::iterator end;
-#ifndef PREFR_USE_OPENMP
-    end = _distances->begin( ) + _aliveParticles;
-#else
-    end = _distances->end( );
-#endif
+    // Distances are still sorted from the last frame.
+    if( _skipSort )
+      return;
 
-#ifdef PREFR_USE_OPENMP
-    if( _parallel )
-    {
-#ifdef _WINDOWS
-    concurrency::parallel_sort(_distances->begin( ), end,
-                                  DistanceArray::sortDescending );
-#else
-    __gnu_parallel::sort( _distances->begin( ), end,
-                          DistanceArray::sortDescending );
-#endif
-    }
+    // Distances are packed at the beginning of the array, and only alive
+    // particles are written unless dead ones are rendered too.
+    unsigned int size = _distances->current;
+
+    if( _incremental )
+      _incrementalSort( size );
     else
-      std::sort( _distances->begin( ), end, DistanceArray::sortDescending );
-#endif
+      _fullSort( 0, size );
+
+    _sorted = true;
 
 #ifdef PREFR_WITH_LOGGING
     std::cout << "SORT" << std::endl;
@@ -94,34 +131,214 @@ namespace prefr
 #endif
   }
 
+  void Sorter::_fullSort( unsigned int begin, unsigned int end )
+  {
+    if( _algorithm == Radix )
+    {
+      _radixSort( begin, end );
+      return;
+    }
+
+#ifdef PREFR_USE_OPENMP
+    if( _parallel )
+    {
+#ifdef _WINDOWS
+    concurrency::parallel_sort( _distances->begin( ) + begin,
+                                _distances->begin( ) + end,
+                                DistanceArray::sortDescending );
+#else
+    __gnu_parallel::sort( _distances->begin( ) + begin,
+                          _distances->begin( ) + end,
+                          DistanceArray::sortDescending );
+#endif
+    }
+    else
+#endif
+      std::sort( _distances->begin( ) + begin, _distances->begin( ) + end,
+                 DistanceArray::sortDescending );
+  }
+
+  void Sorter::_radixSort( unsigned int begin, unsigned int end )
+  {
+    unsigned int size = end - begin;
+
+    _sortScratch.resize( size );
+
+    radix::sortDescending( &_distances->at( begin ), _sortScratch.data( ),
+                           size, _parallel );
+  }
+
+  void Sorter::_incrementalSort( unsigned int size )
+  {
+    // Full sorts are done for a while after the order was not coherent.
+    if( _incrementalWait > 0 )
+    {
+      --_incrementalWait;
+      _fullSort( 0, size );
+      _storeSortedIds( size );
+      return;
+    }
+
+    if( _coherentUnits.size( ) != _distances->elements.size( ))
+      _coherentUnits.assign( _distances->elements.size( ), CoherentUnit( ));
+
+    if( ++_sortStamp == 0 )
+      ++_sortStamp;
+
+    // Store distances by id, usually in ascending order.
+    for( unsigned int i = 0; i < size; ++i )
+    {
+      const DistanceUnit& unit = _distances->at( i );
+      CoherentUnit& coherent = _coherentUnits[ unit.id( )];
+
+      coherent.distance = unit.distance( );
+      coherent.stamp = _sortStamp;
+    }
+
+    // Gather distances following the order of the last frame, skipping the
+    // particles that are gone.
+    _coherentOrder.resize( size );
+
+    unsigned int reused = 0;
+    for( int id : _previousIds )
+    {
+      CoherentUnit& coherent = _coherentUnits[ id ];
+      if( coherent.stamp != _sortStamp )
+        continue;
+
+      coherent.stamp = 0;
+      _coherentOrder[ reused++ ] = DistanceUnit( id, coherent.distance );
+    }
+
+    // Particles not sorted in the last frame, and the ones breaking the
+    // order of the gathered run, are sorted apart.
+    _freshUnits.clear( );
+    for( unsigned int i = 0; i < size; ++i )
+    {
+      const DistanceUnit& unit = _distances->at( i );
+      if( _coherentUnits[ unit.id( )].stamp == _sortStamp )
+        _freshUnits.push_back( unit );
+    }
+
+    unsigned int kept = _splitSorted( reused );
+    unsigned int unsorted = size - kept;
+
+    std::copy( _freshUnits.begin( ), _freshUnits.end( ),
+               _distances->begin( ) + kept );
+
+    // Merge both runs, unless too many particles are unsorted.
+    if( unsorted * incrementalUnsorted > size )
+      _fullSort( 0, size );
+    else if( unsorted > 0 )
+    {
+      _fullSort( kept, size );
+      std::inplace_merge( _distances->begin( ),
+                          _distances->begin( ) + kept,
+                          _distances->begin( ) + size,
+                          DistanceArray::sortDescending );
+    }
+
+    // Back off when the last order was not coherent, as the distances are
+    // likely to keep changing their order in the next frames.
+    if(( reused - kept ) * incrementalUnsorted > reused )
+    {
+      _incrementalBackoff = std::min( std::max( 2 * _incrementalBackoff, 1u ),
+                                      incrementalMaxBackoff );
+      _incrementalWait = _incrementalBackoff;
+    }
+    else
+      _incrementalBackoff = 0;
+
+    _storeSortedIds( size );
+  }
+
+  unsigned int Sorter::_splitSorted( unsigned int size )
+  {
+    // A distance is kept when it follows the last kept one and precedes the
+    // next one, so single particles jumping far away do not discard the
+    // rest of the run.
+    unsigned int kept = 0;
+    for( unsigned int i = 0; i < size; ++i )
+    {
+      const DistanceUnit& unit = _coherentOrder[ i ];
+
+      bool sorted =
+          ( kept == 0 || !DistanceArray::sortDescending(
+              unit, _distances->at( kept - 1 ))) &&
+          ( i + 1 == size || !DistanceArray::sortDescending(
+              _coherentOrder[ i + 1 ], unit ));
+
+      if( sorted )
+        _distances->at( kept++ ) = unit;
+      else
+        _freshUnits.push_back( unit );
+    }
+
+    return kept;
+  }
+
+  void Sorter::_storeSortedIds( unsigned int size )
+  {
+    _previousIds.resize( size );
+    for( unsigned int i = 0; i < size; ++i )
+      _previousIds[ i ] = _distances->at( i ).id( );
+  }
+
   void Sorter::updateCameraDistance( const glm::vec3& cameraPosition,
                                      bool renderDeadParticles )
   {
-    _distances->resetCounter( );
+    _updateKeyAxis( );
 
-#ifdef PREFR_USE_OPENMP
+    _skipSort = _incremental && _sorted && !_particlesChanged &&
+                cameraPosition == _lastCameraPosition &&
+                _keyAxis == _lastKeyAxis &&
+                renderDeadParticles == _lastRenderDeadParticles;
+
+    if( _skipSort )
+      return;
+
+    _sorted = false;
+    _particlesChanged = false;
+    _lastCameraPosition = cameraPosition;
+    _lastKeyAxis = _keyAxis;
+    _lastRenderDeadParticles = renderDeadParticles;
 
-    #pragma omp parallel for if( _parallel )
-    for( int i = 0; i < ( int ) _sources->size( ); ++i)
+    // Keys computed during the update can be used if the camera did not
+    // change since then. Compacted dead particles are not updated.
+    bool fused = _keysValid && cameraPosition == _keysCamera &&
+                 _keyAxis == _keysAxis;
+
+    if( _compactAlive && !renderDeadParticles )
     {
-      Source* source = ( *_sources )[ i ];
-#else
+      _updateAliveDistances( cameraPosition, fused );
+      return;
+    }
 
-    for( auto& source : *_sources )
+    _distances->resetCounter( );
+
+    if( _batched( ))
     {
+      _updateDistances( cameraPosition, renderDeadParticles,
+                        fused && !_compactAlive );
+      return;
+    }
 
-#endif
+    // Keep the behavior of derived sorters re-implementing
+    // updateParticleDistance, which writes distances sequentially.
+    for( auto& source : *_sources )
+    {
       if( source->particles( ).empty( ) || !source->active( ))
         continue;
 
-      // TODO
-      for( auto particle : source->particles( ))
+      const ParticleCollection& particles = source->particles( );
+      for( auto idx : particles.indices( ))
       {
-        {
-            updateParticleDistance( &particle, cameraPosition,
-                                    renderDeadParticles );
-        }
+        ParticleRef current = particles.ref( idx );
+        if( !current.alive( ) && !renderDeadParticles )
+          continue;
 
+        updateParticleDistance( current, cameraPosition,
+                                renderDeadParticles );
       }
     }
 
@@ -144,6 +361,130 @@ namespace prefr
 #endif
   }
 
+  unsigned int Sorter::_aliveOffsets(
+      std::vector< unsigned int >& offsets ) const
+  {
+    offsets.resize( _sources->size( ));
+
+    unsigned int total = 0;
+    for( unsigned int i = 0; i < _sources->size( ); ++i )
+    {
+      Source* source = ( *_sources )[ i ];
+      offsets[ i ] = total;
+
+      if( source->particles( ).empty( ) || !source->active( ))
+        continue;
+
+      total += source->_aliveIndices.size( );
+    }
+
+    assert( total <= _distances->elements.size( ));
+
+    return total;
+  }
+
+  void Sorter::_updateDistances( const glm::vec3& cameraPosition,
+                                 bool renderDeadParticles, bool fused )
+  {
+    _distanceSpans.clear( );
+    for( auto source : *_sources )
+    {
+      if( source->particles( ).empty( ) || !source->active( ))
+        continue;
+
+      IndexSpans spans = source->particles( ).spans( distanceSpanLength );
+      _distanceSpans.insert( _distanceSpans.end( ),
+                             spans.begin( ), spans.end( ));
+    }
+
+    int numSpans = _distanceSpans.size( );
+    _spanOffsets.resize( numSpans + 1 );
+    _spanOffsets[ 0 ] = 0;
+
+    // Stream compaction: count the distances written by each span, turn the
+    // counts into offsets, and write each span from its own offset.
+#ifdef PREFR_USE_OPENMP
+    #pragma omp parallel for if( _parallel ) schedule( dynamic )
+#endif
+    for( int s = 0; s < numSpans; ++s )
+    {
+      const IndexSpan& span = _distanceSpans[ s ];
+
+      unsigned int count = span.size( );
+      if( !renderDeadParticles )
+      {
+        count = 0;
+        for( unsigned int idx = span.begin; idx < span.end; ++idx )
+          count += _particles.ref( idx ).alive( ) ? 1 : 0;
+      }
+
+      _spanOffsets[ s + 1 ] = count;
+    }
+
+    for( int s = 0; s < numSpans; ++s )
+      _spanOffsets[ s + 1 ] += _spanOffsets[ s ];
+
+    unsigned int total = _spanOffsets[ numSpans ];
+    assert( total <= _distances->elements.size( ));
+
+#ifdef PREFR_USE_OPENMP
+    #pragma omp parallel for if( _parallel ) schedule( dynamic )
+#endif
+    for( int s = 0; s < numSpans; ++s )
+    {
+      const IndexSpan& span = _distanceSpans[ s ];
+      unsigned int offset = _spanOffsets[ s ];
+
+      for( unsigned int idx = span.begin; idx < span.end; ++idx )
+      {
+        ParticleRef current = _particles.ref( idx );
+        if( !current.alive( ) && !renderDeadParticles )
+          continue;
+
+        _distances->at( offset++ ) = DistanceUnit(
+            idx, fused ? _keys[ idx ] :
+                         _key( current.position( ), cameraPosition ));
+      }
+    }
+
+    _distances->current = total;
+  }
+
+  void Sorter::_updateAliveDistances( const glm::vec3& cameraPosition,
+                                      bool fused )
+  {
+    // Each source writes its alive particles from its own offset.
+    std::vector< unsigned int > offsets;
+    unsigned int total = _aliveOffsets( offsets );
+
+    for( unsigned int i = 0; i < _sources->size( ); ++i )
+    {
+      Source* source = ( *_sources )[ i ];
+      if( source->particles( ).empty( ) || !source->active( ))
+        continue;
+
+      const std::vector< unsigned int >& indices =
+          source->_aliveIndices.vector( );
+      unsigned int offset = offsets[ i ];
+
+#ifdef PREFR_USE_OPENMP
+      #pragma omp parallel for if( _parallel )
+#endif
+      for( int j = 0; j < ( int ) indices.size( ); ++j )
+      {
+        unsigned int idx = indices[ j ];
+        DistanceUnit& dist = _distances->at( offset + j );
+
+        dist.id( idx );
+        dist.distance( fused ? _keys[ idx ] :
+                       _key( _particles.ref( idx ).position( ),
+                             cameraPosition ));
+      }
+    }
+
+    _distances->current = total;
+  }
+
   void Sorter::updateCameraDistance( bool renderDeadParticles )
   {
     assert( _distances->_camera );
@@ -153,31 +494,25 @@ namespace prefr
 
   }
 
-  void Sorter::updateParticleDistance( const tparticle_ptr current,
+  void Sorter::updateParticleDistance( const ParticleRef& current,
                                        const glm::vec3& cameraPosition,
                                        bool renderDeadParticles )
   {
 
-    DistanceUnit& dist =
-#ifdef PREFR_USE_OPENMP
-    _distances->at( current->id( ));
-#else
-    *_distances->next( );
-#endif
+    DistanceUnit& dist = *_distances->next( );
 
-    dist.id( current->id( ));
-    dist.distance( current->alive() || renderDeadParticles ?
-                   glm::length( current->position( ) - cameraPosition ) :
-                   -1 );
+    dist.id( current.id( ));
+    dist.distance( current.alive() || renderDeadParticles ?
+                   _key( current.position( ), cameraPosition ) : -1 );
 
 #ifdef PREFR_WITH_LOGGING
-    std::cout << "Particle " << current->id( )
-              << "\t" << std::boolalpha << current->alive( )
-              << "\t" << current->position( ).x
-              << "\t" << current->position( ).y
-              << "\t" << current->position( ).z
+    std::cout << "Particle " << current.id( )
+              << "\t" << std::boolalpha << current.alive( )
+              << "\t" << current.position( ).x
+              << "\t" << current.position( ).y
+              << "\t" << current.position( ).z
               << "\t" << dist.distance( )
-              << "\t" << _distances->elements[ current->id( )].distance( )
+              << "\t" << _distances->elements[ current.id( )].distance( )
               << std::endl;
 #endif
   }
@@ -196,4 +531,99 @@ namespace prefr
   {
     _aliveParticles = alive;
   }
+
+  void Sorter::algorithm( SortAlgorithm algorithm_ )
+  {
+    _algorithm = algorithm_;
+  }
+
+  Sorter::SortAlgorithm Sorter::algorithm( void ) const
+  {
+    return _algorithm;
+  }
+
+  void Sorter::incremental( bool incremental_ )
+  {
+    _incremental = incremental_;
+
+    _previousIds.clear( );
+    _incrementalBackoff = 0;
+    _incrementalWait = 0;
+    _sorted = false;
+  }
+
+  bool Sorter::incremental( void ) const
+  {
+    return _incremental;
+  }
+
+  void Sorter::distanceKey( DistanceKey key )
+  {
+    _distanceKey = key;
+    _keysValid = false;
+    _sorted = false;
+  }
+
+  Sorter::DistanceKey Sorter::distanceKey( void ) const
+  {
+    return _distanceKey;
+  }
+
+  void Sorter::updateParticleKeys( const ParticleSpan& particles )
+  {
+    auto positions = particles.attribute< attrib::Position >( );
+
+    const float* position[ 3 ];
+    for( unsigned int c = 0; c < 3; ++c )
+      position[ c ] = positions.component( c );
+
+    float* keys = &_keys[ particles.begin ];
+    const float camera[ 3 ] = { _keysCamera.x, _keysCamera.y, _keysCamera.z };
+
+    if( _depthKey )
+    {
+      const float axis[ 3 ] = { _keysAxis.x, _keysAxis.y, _keysAxis.z };
+      simd::cameraDepths( position, keys, particles.length, camera, axis );
+    }
+    else
+      simd::cameraDistances( position, keys, particles.length, camera,
+                             _distanceKey != Distance );
+  }
+
+  void Sorter::_updateKeyAxis( void )
+  {
+    _depthKey = _distanceKey == Depth && _distances && _distances->_camera;
+
+    if( !_depthKey )
+    {
+      _keyAxis = glm::vec3( 0.0f );
+      return;
+    }
+
+    // The camera looks along the negative Z axis of the view space.
+    glm::mat4x4 view = _distances->_camera->PReFrCameraViewMatrix( );
+    _keyAxis = glm::vec3( -view[ 0 ][ 2 ], -view[ 1 ][ 2 ], -view[ 2 ][ 2 ]);
+  }
+
+  float Sorter::_key( const glm::vec3& position,
+                      const glm::vec3& cameraPosition ) const
+  {
+    glm::vec3 offset = position - cameraPosition;
+
+    if( _depthKey )
+      return glm::dot( offset, _keyAxis );
+
+    float distance = glm::dot( offset, offset );
+    return _distanceKey == Distance ? std::sqrt( distance ) : distance;
+  }
+
+  void Sorter::_prepareKeys( const glm::vec3& cameraPosition )
+  {
+    _updateKeyAxis( );
+
+    _keys.resize( _particles.size( ));
+    _keysCamera = cameraPosition;
+    _keysAxis = _keyAxis;
+    _keysValid = true;
+  }
 }
@@ -25,7 +25,9 @@
 
 #include <prefr/api.h>
 
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 #include "../utils/types.h"
 
@@ -43,6 +45,7 @@ namespace prefr
   class Sorter
   {
     friend class ParticleSystem;
+    friend class GLComputeParticleSystem;
 
   public:
 
@@ -52,6 +55,19 @@ namespace prefr
       Ascending = 1,
     };
 
+    enum SortAlgorithm
+    {
+      Comparison = 0,
+      Radix
+    };
+
+    enum DistanceKey
+    {
+      Distance = 0,
+      SquaredDistance,
+      Depth
+    };
+
     PREFR_API Sorter( );
 
     PREFR_API virtual ~Sorter( );
@@ -66,7 +82,7 @@ namespace prefr
     void updateCameraDistance( bool renderDeadParticles = false );
 
     PREFR_API
-    virtual void updateParticleDistance( const tparticle_ptr current,
+    virtual void updateParticleDistance( const ParticleRef& current,
                                          const glm::vec3& cameraPosition,
                                          bool renderDeadParticles = false );
 
@@ -75,10 +91,99 @@ namespace prefr
     PREFR_API void particles( const ParticleRange& particles );
 
     PREFR_API void aliveParticles( unsigned int alive );
+
+    /*! \brief Sets the algorithm used to sort distances.
+     *
+     * Comparison sorts distance units with std::sort, or with the parallel
+     * sort of the platform when running in parallel. Radix sorts distance
+     * units in place with a LSD radix sort on the distance bits, using
+     * every thread when running in parallel. Radix is used by default.
+     *
+     * @param algorithm Algorithm used to sort distances.
+     */
+    PREFR_API void algorithm( SortAlgorithm algorithm );
+
+    /*! \brief Returns the algorithm used to sort distances. */
+    PREFR_API SortAlgorithm algorithm( void ) const;
+
+    /*! \brief Activates sorting from the previous frame order.
+     *
+     * Particles and camera usually move a little between frames, so the
+     * previous order is almost valid. When activated, distances are placed
+     * following the previous sorted order, and only new particles and the
+     * ones breaking that order are sorted and merged with the rest. When
+     * too many particles changed their order, a full sort with the selected
+     * algorithm is done instead.
+     *
+     * Besides, distances are neither updated nor sorted when the camera
+     * position and the particles did not change since the last sort. By
+     * default, incremental sorting is deactivated.
+     *
+     * @param incremental true to activate, false to deactivate.
+     */
+    PREFR_API void incremental( bool incremental );
+
+    /*! \brief Returns true if incremental sorting is active. */
+    PREFR_API bool incremental( void ) const;
+
+    /*! \brief Sets the value particles are sorted by.
+     *
+     * Distance sorts by the distance to the camera position, and is used by
+     * default. SquaredDistance gives the same order saving a square root
+     * per particle. Depth sorts by the depth along the view direction of
+     * the camera given to initDistanceArray, and falls back to
+     * SquaredDistance when there is no camera.
+     *
+     * @param key Value particles are sorted by.
+     */
+    PREFR_API void distanceKey( DistanceKey key );
+
+    /*! \brief Returns the value particles are sorted by. */
+    PREFR_API DistanceKey distanceKey( void ) const;
+
+    /*! \brief Computes the sort keys of a range of particles.
+     *
+     * Called by updaters right after moving the particles when camera
+     * distances are fused with the update stage, so positions are read
+     * while still in cache. Keys are stored by particle id, and gathered by
+     * the next updateCameraDistance call with the same camera.
+     *
+     * @param particles Particles to compute their keys.
+     *
+     * @see ParticleSystem::fuseCameraDistances
+     */
+    PREFR_API void updateParticleKeys( const ParticleSpan& particles );
+
 protected:
 
+    /*! \brief Returns true if distances can be computed in batches by the
+     * built-in behavior. Derived sorters re-implementing
+     * Sorter#updateParticleDistance must re-implement this method to return
+     * false.
+     */
+    PREFR_API virtual bool _batched( void ) const;
+
+    void _fullSort( unsigned int begin, unsigned int end );
+    void _radixSort( unsigned int begin, unsigned int end );
+    void _incrementalSort( unsigned int size );
+    unsigned int _splitSorted( unsigned int size );
+    void _storeSortedIds( unsigned int size );
+
     void sources( std::vector< Source* >* sources_ );
 
+    unsigned int _aliveOffsets( std::vector< unsigned int >& offsets ) const;
+
+    void _updateDistances( const glm::vec3& cameraPosition,
+                           bool renderDeadParticles, bool fused );
+    void _updateAliveDistances( const glm::vec3& cameraPosition,
+                                bool fused );
+
+    void _updateKeyAxis( void );
+    float _key( const glm::vec3& position,
+                const glm::vec3& cameraPosition ) const;
+
+    void _prepareKeys( const glm::vec3& cameraPosition );
+
     ParticleCollection _particles;
 
     std::vector< Source* >* _sources;
@@ -89,6 +194,70 @@ protected:
 
     bool _parallel;
 
+    /*! Only alive particles are written to the distance array, packed
+     * at its beginning following each source's alive indices. */
+    bool _compactAlive;
+
+    SortAlgorithm _algorithm;
+
+    /*! Spans of source particles and the offset of the distances written
+     * by each span, used to compact distances in parallel. */
+    IndexSpans _distanceSpans;
+    std::vector< unsigned int > _spanOffsets;
+
+    /*! Scratch buffer used by radix sorting. */
+    std::vector< DistanceUnit > _sortScratch;
+
+    bool _incremental;
+
+    /*! Particles changed since the last sort. Set by ParticleSystem. */
+    bool _particlesChanged;
+
+    /*! The distance array holds the sorted distances of the last frame. */
+    bool _sorted;
+    bool _skipSort;
+
+    glm::vec3 _lastCameraPosition;
+    bool _lastRenderDeadParticles;
+
+    /*! Distance of each particle, indexed by id, stamped with the sort
+     * that stored it. */
+    struct CoherentUnit
+    {
+      CoherentUnit( void )
+      : distance( -1.0f )
+      , stamp( 0 )
+      { }
+
+      float distance;
+      uint32_t stamp;
+    };
+
+    /*! Ids in the order of the last sorted frame. */
+    std::vector< int > _previousIds;
+    std::vector< CoherentUnit > _coherentUnits;
+    std::vector< DistanceUnit > _coherentOrder;
+    std::vector< DistanceUnit > _freshUnits;
+    uint32_t _sortStamp;
+
+    /*! Full sorts to be done before trying incremental sorting again. */
+    unsigned int _incrementalBackoff;
+    unsigned int _incrementalWait;
+
+    DistanceKey _distanceKey;
+
+    /*! View direction used by depth keys, if available. */
+    bool _depthKey;
+    glm::vec3 _keyAxis;
+    glm::vec3 _lastKeyAxis;
+
+    /*! Keys computed during the update stage, indexed by particle id, and
+     * the camera they were computed from. */
+    std::vector< float > _keys;
+    glm::vec3 _keysCamera;
+    glm::vec3 _keysAxis;
+    bool _keysValid;
+
   };
 }
 
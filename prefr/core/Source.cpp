@@ -24,6 +24,9 @@
 
 #include "../utils/types.h"
 
+#include <algorithm>
+#include <functional>
+
 namespace prefr
 {
     Source::Source( float emissionRate_,
@@ -32,8 +35,11 @@ namespace prefr
     : _updateConfig( nullptr )
     , _sampler( sampler_ )
     , _position( position_ )
+    , _freeIndicesSize( 0 )
+    , _freeIndicesSorted( 0 )
     , _particlesToEmit( 0 )
     , _aliveParticles( 0 )
+    , _aliveParticlesDelta( 0 )
     , _lastFrameAliveParticles( 0 )
     , _currentFrameEmittedParticles( 0 )
     , _emittedParticles( 0 )
@@ -102,12 +108,16 @@ namespace prefr
       _emittedParticles = 0;
       _continueEmission = true;
 
-      for( auto const & particle : _particles )
+      for( auto idx : _particles.indices( ))
       {
-        _updateConfig->setEmitted( particle.id( ), false );
-        _updateConfig->setDead( particle.id( ), true );
+        _updateConfig->setEmitted( idx, false );
+        _updateConfig->setDead( idx, true );
       }
 
+      _aliveIndices.clear( );
+
+      _rebuildFreeIndices( );
+
       _particlesToEmit = _particles.size( );
     }
 
@@ -171,23 +181,46 @@ namespace prefr
 
     void Source::_finishFrame( void )
     {
-
       _particlesBudget = 0;
 
       _lastFrameAliveParticles = _aliveParticles;
 
-      _aliveParticles = 0;
+      for( auto idx : _emittedIndices )
+        _updateConfig->setEmitted( idx, false );
+
+      _emittedIndices.clear( );
+
+      _aliveParticles += _aliveParticlesDelta;
+      _aliveParticlesDelta = 0;
+
+      if( _updateConfig->compactAlive( ))
+        _compactAliveIndices( );
+    }
 
-      for( auto const & particle : _particles )
+    void Source::_compactAliveIndices( void )
+    {
+      // Order is kept so the list stays sorted for the update.
+      _aliveIndices.removeIf( [ this ]( unsigned int idx )
       {
-        _updateConfig->setEmitted( particle.id( ), false );
+        return _updateConfig->source( idx ) != this ||
+               !_particles.ref( idx ).alive( );
+      });
+    }
 
-        if( particle.alive( ))
-        {
-          _aliveParticles++;
-        }
-      }
+    void Source::_rebuildAliveIndices( void )
+    {
+      _aliveIndices.clear( );
+
+      if( !_updateConfig || !_updateConfig->compactAlive( ))
+        return;
+
+      _aliveIndices.reserve( _particles.size( ));
 
+      for( auto idx : _particles.indices( ))
+      {
+        if( _particles.ref( idx ).alive( ) || _updateConfig->emitted( idx ))
+          _aliveIndices.push_back( idx );
+      }
     }
 
     void Source::_checkFinished( )
@@ -217,24 +250,132 @@ namespace prefr
     {
       assert( _sampler );
 
+      if( _updateConfig )
+        sampledValues->random = _updateConfig->random( ).stream(
+            sampledValues->index, RandomContext::sampleStream );
+
       _sampler->sample( *this, sampledValues );
 
     }
 
+    void Source::sampleBatch( SampledBatch& batch )
+    {
+      assert( _sampler );
+
+      if( _updateConfig )
+        batch.random = _updateConfig->random( );
+
+      _sampler->sampleBatch( *this, batch );
+    }
+
     void Source::_initializeParticles( void )
     {
       if( _particles.size( ) > 0 )
       {
-        for( auto particle : _particles )
+        for( auto idx : _particles.indices( ))
         {
-          particle.set_alive( false );
-          _updateConfig->setDead( particle.id( ), true );
-          _updateConfig->setEmitted( particle.id( ), false );
+          _particles.ref( idx ).set_alive( false );
+          _updateConfig->setDead( idx, true );
+          _updateConfig->setEmitted( idx, false );
         }
 
         _emittedIndices.clear( );
         _emittedIndices.reserve( _particles.size( ));
       }
+
+      _aliveIndices.clear( );
+
+      _rebuildFreeIndices( );
+    }
+
+    void Source::_rebuildFreeIndices( void )
+    {
+      _freeIndices.resize( _particles.size( ));
+      _freeIndicesSize = 0;
+
+      _aliveParticlesDelta = 0;
+
+      if( !_updateConfig )
+        return;
+
+      const FlagsArray& dead = _updateConfig->deadFlags( );
+      for( auto const& span : _particles.spans( ))
+      {
+        for( size_t idx = dead.findNext( span.begin, span.end, true );
+             idx < span.end;
+             idx = dead.findNext( idx + 1, span.end, true ))
+          _freeIndices[ _freeIndicesSize++ ] = idx;
+      }
+
+      // Reverse so particles are emitted in ascending order.
+      std::reverse( _freeIndices.begin( ),
+                    _freeIndices.begin( ) + _freeIndicesSize );
+
+      _freeIndicesSorted = _freeIndicesSize;
+
+      _aliveParticles = _particles.size( ) - _freeIndicesSize;
+    }
+
+    void Source::_sortFreeIndices( void )
+    {
+      // Particles released since the last emission are popped in ascending
+      // order, as the ones of a rebuilt stack.
+      if( _freeIndicesSorted < _freeIndicesSize )
+        std::sort( _freeIndices.begin( ) + _freeIndicesSorted,
+                   _freeIndices.begin( ) + _freeIndicesSize,
+                   std::greater< unsigned int >( ));
+
+      _freeIndicesSorted = _freeIndicesSize;
+    }
+
+    void Source::_releaseParticle( unsigned int idx )
+    {
+      // Called by UpdateConfig::setDead, possibly from several threads.
+      unsigned int position;
+
+#ifdef PREFR_USE_OPENMP
+      #pragma omp atomic capture
+#endif
+      position = _freeIndicesSize++;
+
+      // Stale entries can fill the stack up, in which case it is rebuilt
+      // before the next emission.
+      if( position < _freeIndices.size( ))
+        _freeIndices[ position ] = idx;
+
+#ifdef PREFR_USE_OPENMP
+      #pragma omp atomic
+#endif
+      --_aliveParticlesDelta;
+    }
+
+    bool Source::_popFreeIndex( unsigned int& idx )
+    {
+      while( _freeIndicesSize > 0 )
+      {
+        idx = _freeIndices[ --_freeIndicesSize ];
+
+        // Skip entries left by particles revived or moved to other sources.
+        if( _updateConfig->dead( idx ) && _updateConfig->source( idx ) == this )
+          return true;
+      }
+
+      return false;
+    }
+
+    void Source::_emitParticle( unsigned int idx )
+    {
+      _updateConfig->setEmitted( idx, true );
+      _updateConfig->setDead( idx, false );
+
+      _emittedIndices.push_back( idx );
+
+      ++_aliveParticlesDelta;
+
+      if( _updateConfig->compactAlive( ))
+        _aliveIndices.push_back( idx );
+
+      ++_currentFrameEmittedParticles;
     }
 
     void Source::_prepareParticles( void )
@@ -246,45 +387,32 @@ namespace prefr
 
       _currentFrameEmittedParticles = 0;
 
-      // Fill dead pool for the emission for this frame with all particles
-      if( _emissionRate <= 0.0f )
-      {
-        for( auto const & particle : _particles )
-        {
-          if( _updateConfig->dead( particle.id( )))
-          {
-            _updateConfig->setEmitted( particle.id( ), true );
-            _updateConfig->setDead( particle.id( ), false );
+      if( _freeIndicesSize > _freeIndices.size( ))
+        _rebuildFreeIndices( );
+      else
+        _sortFreeIndices( );
 
-            _emittedIndices.insert(
-                std::make_pair( particle.id( ), _currentFrameEmittedParticles ));
+      unsigned int idx;
 
-            ++_currentFrameEmittedParticles;
-          }
-        }
+      // Emit every dead particle
+      if( _emissionRate <= 0.0f )
+      {
+        while( _popFreeIndex( idx ))
+          _emitParticle( idx );
       }
       else
       {
-        // Fill dead pool for the emission for this frame according to budget
-        for( auto const& particle : _particles )
+        // Emit dead particles according to budget
+        while( _particlesBudget > 0 && _popFreeIndex( idx ))
         {
-          if( _particlesBudget == 0 )
-            break;
-
-          if( !_updateConfig->dead( particle.id( )))
-            continue;
-
-          _updateConfig->setEmitted( particle.id( ), true );
-          _updateConfig->setDead( particle.id( ), false );
-
-          _emittedIndices.insert(
-              std::make_pair( particle.id( ), _currentFrameEmittedParticles ));
+          _emitParticle( idx );
 
           --_particlesBudget;
-          ++_currentFrameEmittedParticles;
         }
       }
 
+      _freeIndicesSorted = _freeIndicesSize;
+
       _emittedParticles += _currentFrameEmittedParticles;
     }
 
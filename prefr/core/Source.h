@@ -27,6 +27,7 @@
 
 #include "../utils/types.h"
 #include "../utils/Timer.hpp"
+#include "../utils/SparseSet.hpp"
 
 #include "Particles.h"
 #include "Cluster.h"
@@ -45,11 +46,35 @@ namespace prefr
   public:
 
     unsigned int index;
+
+    /*! Random numbers of the sampled particle for the current frame. */
+    RandomStream random;
+
     glm::vec3 position;
     glm::vec3 direction;
     glm::mat4 rotation;
   };
 
+  /*! \brief Values sampled for a batch of particles, stored as one array
+   * per component. Arrays hold at least count elements.
+   */
+  class SampledBatch
+  {
+  public:
+
+    /*! Number of particles to sample. */
+    unsigned int count;
+
+    /*! Indices of the sampled particles. */
+    const uint32_t* indices;
+
+    /*! Random numbers context of the current frame. */
+    RandomContext random;
+
+    float* position[ 3 ];
+    float* direction[ 3 ];
+  };
+
   /*! \class Source
    *
    * \brief This class provides the base for the emission of particles for
@@ -69,6 +94,9 @@ namespace prefr
     friend class ParticleSystem;
     friend class Cluster;
     friend class Updater;
+    friend class Sorter;
+    friend class UpdateConfig;
+    friend class GLComputeParticleSystem;
 
   public:
 
@@ -103,6 +131,15 @@ namespace prefr
     PREFR_API glm::vec3 position( void ) const;
     PREFR_API virtual void sample( SampledValues* );
 
+    /*! \brief Samples the position and direction of a batch of particles.
+     *
+     * Fills the random context of the batch and samples it through the
+     * Sampler. Re-implement along with Source#sample when changing the
+     * sampling behavior, as the update pass samples emitted particles in
+     * batches.
+     */
+    PREFR_API virtual void sampleBatch( SampledBatch& batch );
+
     PREFR_API unsigned int aliveParticles( void ) const;
 
     PREFR_API void autoDeactivateWhenFinished( bool state );
@@ -117,6 +154,15 @@ namespace prefr
     virtual void _initializeParticles( void );
     virtual void _prepareParticles( void );
 
+    void _compactAliveIndices( void );
+    void _rebuildAliveIndices( void );
+
+    void _rebuildFreeIndices( void );
+    void _sortFreeIndices( void );
+    void _releaseParticle( unsigned int idx );
+    bool _popFreeIndex( unsigned int& idx );
+    void _emitParticle( unsigned int idx );
+
     ParticleCollection _particles;
     UpdateConfig* _updateConfig;
 
@@ -124,11 +170,32 @@ namespace prefr
 
     glm::vec3 _position;
 
-    std::unordered_map< unsigned int, unsigned int > _emittedIndices;
+    /*! Particles emitted this frame. */
+    std::vector< unsigned int > _emittedIndices;
+
+    /*! Stack of dead particles available for emission, pushed by
+     * _releaseParticle when particles die. Entries of particles that are no
+     * longer dead or belong to another source are skipped when popped. */
+    std::vector< unsigned int > _freeIndices;
+    unsigned int _freeIndicesSize;
+
+    /*! Entries of the stack already in a fixed order. Entries pushed above
+     * it by concurrent threads are sorted before emitting, so emission does
+     * not depend on thread scheduling. */
+    unsigned int _freeIndicesSorted;
+
+    /*! Particles alive or emitted this frame, only kept when alive
+     * compaction is enabled. Dead particles are removed when the frame is
+     * closed, keeping the order of the remaining ones. */
+    SparseSet< unsigned int > _aliveIndices;
 
     unsigned int _particlesToEmit;
 
+    /*! Particles emitted and not yet dead as of the last closed frame. */
     unsigned int _aliveParticles;
+
+    /*! Births minus deaths since the last closed frame. */
+    int _aliveParticlesDelta;
     unsigned int _lastFrameAliveParticles;
 
     unsigned int _currentFrameEmittedParticles;
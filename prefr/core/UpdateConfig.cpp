@@ -36,6 +36,10 @@ namespace prefr
   , _dead( nullptr )
   , _used( nullptr )
   , _unused( nullptr )
+  , _compactAlive( false )
+  , _sorter( nullptr )
+  , _renderCurves( true )
+  , _referencesChanged( true )
   { }
 
   UpdateConfig::~UpdateConfig( void )
@@ -50,16 +54,16 @@ namespace prefr
   void UpdateConfig::setEmitted( unsigned int idx, bool value )
   {
     assert( idx < _emitted->size( ));
-    ( *_emitted )[ idx ] = value;
+    _emitted->set( idx, value );
   }
 
   void UpdateConfig::setEmitted( const ParticleSet& indices, bool value )
   {
-    for( auto idx : indices )
+    indices.forEachSpan( [ this, value ]( unsigned int begin, unsigned int end )
     {
-      assert( idx < _emitted->size( ));
-      ( *_emitted )[ idx ] = value;
-    }
+      assert( end <= _emitted->size( ));
+      _emitted->fill( begin, end, value );
+    });
   }
 
   bool UpdateConfig::dead( unsigned int idx ) const
@@ -71,16 +75,32 @@ namespace prefr
   void UpdateConfig::setDead( unsigned int idx, bool value )
   {
     assert( idx < _dead->size( ));
-    ( *_dead )[ idx ] = value;
+
+    // Count newly dead particles and make them available for emission.
+    if( value && !( *_dead )[ idx ])
+    {
+      Source* source_ = source( idx );
+      if( source_ )
+        source_->_releaseParticle( idx );
+    }
+
+    _dead->set( idx, value );
   }
 
   void UpdateConfig::setDead( const ParticleSet& indices, bool value )
   {
-    for( auto idx : indices )
+    indices.forEachSpan( [ this, value ]( unsigned int begin, unsigned int end )
     {
-      assert( idx < _dead->size( ));
-      ( *_dead )[ idx ] = value;
-    }
+      assert( end <= _dead->size( ));
+
+      if( value )
+      {
+        for( unsigned int idx = begin; idx < end; ++idx )
+          setDead( idx, true );
+      }
+      else
+        _dead->fill( begin, end, false );
+    });
   }
 
   Model* UpdateConfig::model( unsigned int idx ) const
@@ -91,10 +111,13 @@ namespace prefr
 
   void UpdateConfig::setModel( Model* model_, const ParticleSet& indices )
   {
-    for( auto idx : indices )
+    _referencesChanged = true;
+
+    indices.forEachSpan( [ this, model_ ]( unsigned int begin, unsigned int end )
     {
-      ( *_refModels )[ idx ] = model_;
-    }
+      std::fill( _refModels->begin( ) + begin, _refModels->begin( ) + end,
+                 model_ );
+    });
   }
 
   Source* UpdateConfig::source( unsigned int idx ) const
@@ -107,6 +130,8 @@ namespace prefr
   {
     assert( source_ );
 
+    _referencesChanged = true;
+
     std::set< Source* > sources;
 
     for( auto idx : indices )
@@ -125,28 +150,32 @@ namespace prefr
     }
 
     for( auto s : sources )
+    {
       s->particles( ).removeIndices( indices );
+      s->_rebuildFreeIndices( );
+    }
 
     _used->addIndices( indices );
     _unused->removeIndices( indices );
 
     source_->particles( ).addIndices( indices );
 
+    source_->_rebuildFreeIndices( );
   }
 
   void UpdateConfig::removeSourceIndices( Source* source_,
                                           const ParticleSet& indices )
   {
-    for( auto idx : indices )
+    _referencesChanged = true;
+
+    indices.forEachSpan( [ this ]( unsigned int begin, unsigned int end )
     {
-//      Source* auxSource = source( idx );
-//      if( auxSource == source_ )
-      {
-        (*_refSources )[ idx ] = nullptr;
-        setEmitted( idx, false );
-        setDead( idx, true );
-      }
-    }
+      std::fill( _refSources->begin( ) + begin, _refSources->begin( ) + end,
+                 nullptr );
+    });
+
+    setEmitted( indices, false );
+    setDead( indices, true );
 
     _used->removeIndices( indices );
     _unused->addIndices( indices );
@@ -162,13 +191,44 @@ namespace prefr
 
   void UpdateConfig::setUpdater( Updater* updater_, const ParticleSet& indices )
   {
-    for( auto idx : indices )
+    _referencesChanged = true;
+
+    indices.forEachSpan( [ this, updater_ ]( unsigned int begin, unsigned int end )
     {
-      (*_refUpdaters)[ idx ] = updater_;
-    }
+      std::fill( _refUpdaters->begin( ) + begin, _refUpdaters->begin( ) + end,
+                 updater_ );
+    });
   }
 
+  const FlagsArray& UpdateConfig::emittedFlags( void ) const
+  {
+    return *_emitted;
+  }
 
+  const FlagsArray& UpdateConfig::deadFlags( void ) const
+  {
+    return *_dead;
+  }
+
+  bool UpdateConfig::compactAlive( void ) const
+  {
+    return _compactAlive;
+  }
+
+  const RandomContext& UpdateConfig::random( void ) const
+  {
+    return _random;
+  }
+
+  Sorter* UpdateConfig::sorter( void ) const
+  {
+    return _sorter;
+  }
+
+  bool UpdateConfig::renderCurves( void ) const
+  {
+    return _renderCurves;
+  }
 
 }
 
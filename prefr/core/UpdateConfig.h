@@ -24,19 +24,22 @@
 #define __PREFR_UPDATECONFIG__
 
 #include <vector>
+
+#include "../utils/FlagsArray.hpp"
+#include "../utils/Random.h"
 #include "Particles.h"
 
 namespace prefr
 {
   class Model;
   class Source;
+  class Sorter;
   class Updater;
 
-  typedef std::vector< bool > FlagsArray;
-
   class UpdateConfig
   {
     friend class ParticleSystem;
+    friend class GLComputeParticleSystem;
 
   public:
 
@@ -60,6 +63,21 @@ namespace prefr
     Updater* updater( unsigned int idx ) const;
     void setUpdater( Updater* updater_, const ParticleSet& indices );
 
+    const FlagsArray& emittedFlags( void ) const;
+    const FlagsArray& deadFlags( void ) const;
+
+    bool compactAlive( void ) const;
+
+    const RandomContext& random( void ) const;
+
+    /*! \brief Returns the sorter computing sort keys during the update, or
+     * nullptr when camera distances are not fused with the update. */
+    Sorter* sorter( void ) const;
+
+    /*! \brief Returns false when the renderer evaluates color and size
+     * curves itself, so updaters can skip them. */
+    bool renderCurves( void ) const;
+
   protected:
 
     UpdateConfig( void );
@@ -68,11 +86,23 @@ namespace prefr
     std::vector< Source* >* _refSources;
     std::vector< Updater* >* _refUpdaters;
 
-    std::vector< bool >* _emitted;
-    std::vector< bool >* _dead;
+    FlagsArray* _emitted;
+    FlagsArray* _dead;
 
     ParticleCollection* _used;
     ParticleCollection* _unused;
+
+    bool _compactAlive;
+
+    RandomContext _random;
+
+    Sorter* _sorter;
+
+    bool _renderCurves;
+
+    /*! True when the source, model or updater of any particle changed since
+     * it was last cleared by a simulation backend. */
+    bool _referencesChanged;
   };
 }
 
@@ -21,11 +21,23 @@
  */
 
 #include "Updater.h"
+#include "Sorter.h"
+
+#include "../utils/SIMD.h"
+
+#include <algorithm>
 
 namespace prefr
 {
 
-  static float invRandMax = 1.0f / RAND_MAX;
+  /*! Maximum number of particles checked for death on each kernel call. */
+  static const unsigned int expireBatch = 256;
+
+  /*! Maximum number of particles checked for emission on each batch. */
+  static const unsigned int emitBatch = 256;
+
+  /*! Maximum number of particles evaluated on each batch of curves. */
+  static const unsigned int curvesBatch = 256;
 
   Updater::Updater( void )
   : _updateConfig( nullptr )
@@ -34,7 +46,12 @@ namespace prefr
   Updater::~Updater( )
   { }
 
-  void Updater::updateParticle( tparticle current,
+  bool Updater::_batched( void ) const
+  {
+    return true;
+  }
+
+  void Updater::updateParticle( ParticleRef current,
                                 float deltaTime )
   {
 
@@ -53,8 +70,9 @@ namespace prefr
 
     if( _updateConfig->emitted( id ) && !current.alive( ))
     {
-      current.set_life( glm::clamp( rand( ) * invRandMax, 0.0f, 1.0f ) *
-                     model->_lifeRange + model->_minLife );
+      current.set_life( _updateConfig->random( ).uniform(
+          id, RandomContext::lifeStream ) *
+          model->_lifeRange + model->_minLife );
 
       current.set_alive( true );
 
@@ -86,10 +104,13 @@ namespace prefr
           glm::clamp( current.life( ) * ( model->_lifeNormalization ),
                       0.0f, 1.0f );
 
-      current.set_color( model->color.GetValue( refLife ));
+      if( _updateConfig->renderCurves( ))
+      {
+        current.set_color( model->color.GetLookupValue( refLife ));
+        current.set_size( model->size.GetLookupValue( refLife ));
+      }
 
-      current.set_size( model->size.GetValue( refLife ));
-      current.set_velocityModule( model->velocity.GetValue( refLife ));
+      current.set_velocityModule( model->velocity.GetLookupValue( refLife ));
 
       current.set_position( current.position( ) + current.velocity( ) *
                              current.velocityModule( ) * deltaTime );
@@ -98,4 +119,172 @@ namespace prefr
 
   }
 
+  void Updater::updateRange( const ParticleSpan& particles,
+                             Source* source,
+                             Model* model,
+                             float deltaTime )
+  {
+    if( _batched( ))
+    {
+      _updateRange( particles, source, model, deltaTime );
+      return;
+    }
+
+    // Keep the behavior of derived updaters re-implementing updateParticle.
+    for( unsigned int i = 0; i < particles.length; ++i )
+      updateParticle( particles.data->ref( particles.begin + i ), deltaTime );
+
+    if( _updateConfig->sorter( ))
+      _updateConfig->sorter( )->updateParticleKeys( particles );
+  }
+
+  void Updater::_updateRange( const ParticleSpan& particles,
+                              Source* source,
+                              Model* model,
+                              float deltaTime )
+  {
+    assert( model );
+    assert( source );
+
+    float* life = particles.attribute< attrib::Life >( );
+    char* alive = particles.attribute< attrib::Alive >( );
+    float* velocityModule = particles.attribute< attrib::VelocityModule >( );
+
+    auto positions = particles.attribute< attrib::Position >( );
+    auto velocities = particles.attribute< attrib::Velocity >( );
+
+    // Life decrease. Emitted particles get their initial life afterwards.
+    simd::decreaseLife( life, particles.length, deltaTime );
+
+    // Emission. Initial lives, positions and directions are generated for
+    // each batch of emitted particles at once.
+    uint32_t emittedIds[ emitBatch ];
+    float lifeRandom[ emitBatch ];
+    float sampledPosition[ 3 ][ emitBatch ];
+    float sampledDirection[ 3 ][ emitBatch ];
+
+    SampledBatch batch;
+    batch.indices = emittedIds;
+    for( unsigned int c = 0; c < 3; ++c )
+    {
+      batch.position[ c ] = sampledPosition[ c ];
+      batch.direction[ c ] = sampledDirection[ c ];
+    }
+    for( unsigned int i = 0; i < particles.length; i += emitBatch )
+    {
+      unsigned int count = std::min( emitBatch, particles.length - i );
+      unsigned int emittedCount = 0;
+
+      for( unsigned int j = 0; j < count; ++j )
+      {
+        unsigned int id = particles.begin + i + j;
+
+        if( _updateConfig->emitted( id ) && !alive[ i + j ])
+          emittedIds[ emittedCount++ ] = id;
+      }
+
+      if( emittedCount == 0 )
+        continue;
+
+      _updateConfig->random( ).uniform( emittedIds, lifeRandom, emittedCount,
+                                        RandomContext::lifeStream );
+
+      batch.count = emittedCount;
+      source->sampleBatch( batch );
+
+      for( unsigned int j = 0; j < emittedCount; ++j )
+      {
+        unsigned int id = emittedIds[ j ];
+        unsigned int local = id - particles.begin;
+
+        life[ local ] =
+            lifeRandom[ j ] * model->_lifeRange + model->_minLife;
+
+        alive[ local ] = true;
+
+        for( unsigned int c = 0; c < 3; ++c )
+        {
+          positions.component( c )[ local ] = sampledPosition[ c ][ j ];
+          velocities.component( c )[ local ] = sampledDirection[ c ][ j ];
+        }
+
+        _updateConfig->setEmitted( id, false );
+      }
+    }
+
+    // Attribute curves. Particles reaching the end of their life are still
+    // updated with their last values before being killed. Batches with
+    // every particle alive are evaluated with a single call per curve.
+    // Color and size are skipped when the renderer evaluates them.
+    auto colors = particles.attribute< attrib::Color >( );
+    float* sizes = particles.attribute< attrib::Size >( );
+    bool renderCurves = _updateConfig->renderCurves( );
+
+    float refLife[ curvesBatch ];
+    for( unsigned int i = 0; i < particles.length; i += curvesBatch )
+    {
+      unsigned int count = std::min( curvesBatch, particles.length - i );
+      unsigned int aliveCount = 0;
+
+      for( unsigned int j = 0; j < count; ++j )
+      {
+        refLife[ j ] = 1.0f - glm::clamp(
+            life[ i + j ] * ( model->_lifeNormalization ), 0.0f, 1.0f );
+        aliveCount += alive[ i + j ] ? 1 : 0;
+      }
+
+      if( aliveCount == count )
+      {
+        if( renderCurves )
+        {
+          model->color.GetValues( refLife, colors + i, count );
+          model->size.GetValues( refLife, sizes + i, count );
+        }
+        model->velocity.GetValues( refLife, velocityModule + i, count );
+        continue;
+      }
+
+      for( unsigned int j = 0; j < count; ++j )
+      {
+        if( !alive[ i + j ])
+          continue;
+
+        if( renderCurves )
+        {
+          colors[ i + j ] = model->color.GetLookupValue( refLife[ j ]);
+          sizes[ i + j ] = model->size.GetLookupValue( refLife[ j ]);
+        }
+        velocityModule[ i + j ] =
+            model->velocity.GetLookupValue( refLife[ j ]);
+      }
+    }
+
+    // Integration.
+    float* position[ 3 ];
+    const float* velocity[ 3 ];
+    for( unsigned int c = 0; c < 3; ++c )
+    {
+      position[ c ] = positions.component( c );
+      velocity[ c ] = velocities.component( c );
+    }
+
+    simd::integrate( position, velocity, velocityModule, alive,
+                     particles.length, deltaTime );
+
+    // Sort keys, while positions are still in cache.
+    if( _updateConfig->sorter( ))
+      _updateConfig->sorter( )->updateParticleKeys( particles );
+
+    // Deaths.
+    unsigned int killed[ expireBatch ];
+    for( unsigned int i = 0; i < particles.length; i += expireBatch )
+    {
+      unsigned int size = std::min( expireBatch, particles.length - i );
+      unsigned int count = simd::expire( life + i, alive + i, killed, size );
+
+      for( unsigned int k = 0; k < count; ++k )
+        _updateConfig->setDead( particles.begin + i + killed[ k ], true );
+    }
+  }
+
 }
@@ -59,6 +59,7 @@ namespace prefr
   class Updater
   {
     friend class ParticleSystem;
+    friend class GLComputeParticleSystem;
 
   public:
 
@@ -86,15 +87,53 @@ namespace prefr
      *  other non-default properties added or re-implemented Model objects.
      *
      * @param cluster Cluster owner of the particle to be updated.
-     * @param current tparticle_ptr referencing the particle to be emitted/updated.
+     * @param current ParticleRef referencing the particle to be emitted/updated.
      * @param deltaTime Current delta time to compute attributes variations
      * according to elapsed time since last frame.
      */
-    PREFR_API virtual void updateParticle( tparticle current,
+    PREFR_API virtual void updateParticle( ParticleRef current,
                                            float deltaTime );
 
+    /*! \brief Emit and Update method for a contiguous range of particles.
+     *
+     * Emits and updates a contiguous range of particles sharing the same
+     * source and model. This is the entry point used by ParticleSystem,
+     * which groups particles by source, model and updater.
+     *
+     * Default implementation runs the built-in behavior as a batch over the
+     * span attribute arrays if Updater#_batched returns true, and calls
+     * Updater#updateParticle for each particle otherwise.
+     *
+     * @param particles Span of particles to be emitted/updated.
+     * @param source Source shared by all the particles of the span.
+     * @param model Model shared by all the particles of the span.
+     * @param deltaTime Current delta time to compute attributes variations
+     * according to elapsed time since last frame.
+     */
+    PREFR_API virtual void updateRange( const ParticleSpan& particles,
+                                        Source* source,
+                                        Model* model,
+                                        float deltaTime );
+
   protected:
 
+    /*! \brief Returns true if this updater behaves as the built-in one.
+     *
+     * Particles of batched updaters are updated by the built-in batch
+     * behavior, and can be simulated by accelerated backends. Derived
+     * updaters re-implementing Updater#updateParticle or
+     * Updater#updateRange must re-implement this method to return false.
+     */
+    PREFR_API virtual bool _batched( void ) const;
+
+    /*! \brief Built-in batch behavior. Might be called from re-implemented
+     * Updater#updateRange methods.
+     */
+    void _updateRange( const ParticleSpan& particles,
+                       Source* source,
+                       Model* model,
+                       float deltaTime );
+
     UpdateConfig* _updateConfig;
   };
 
@@ -46,9 +46,15 @@ namespace prefr
 
 #endif
 
+    /*! Host ids and distances, sorted on the device. */
+    std::vector< int > ids;
+    std::vector< float > distances;
+
     CUDADistanceArray ( unsigned int size, ICamera* camera = nullptr )
     : DistanceArray( size, camera )
     {
+      ids.resize( size );
+      distances.resize( size );
       translatedIDs.resize( size );
     }
 
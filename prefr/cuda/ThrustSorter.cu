@@ -48,11 +48,11 @@ namespace prefr
 
     CUDADistanceArray* cda = static_cast< CUDADistanceArray* >( _distances );
 
-    std::vector< int >::iterator hostidbegin = _distances->ids.begin( );
+    std::vector< int >::iterator hostidbegin = cda->ids.begin( );
     std::vector< int >::iterator hostidend = hostidbegin + _aliveParticles;
 
     std::vector< float >::iterator hostdistbegin =
-        _distances->distances.begin( );
+        cda->distances.begin( );
 
     std::vector< float >::iterator hostdistend =
         hostdistbegin  + _aliveParticles;
@@ -93,11 +93,10 @@ namespace prefr
     {
       if( cluster->active( ) || renderDeadParticles )
       {
-        for( tparticle particle = cluster->particles( ).begin( );
-             particle != cluster->particles( ).end( );
-             particle++ )
+        const ParticleCollection& particles = cluster->particles( );
+        for( auto idx : particles.indices( ))
         {
-          updateParticleDistance( &particle, cameraPosition,
+          updateParticleDistance( particles.ref( idx ), cameraPosition,
                                   renderDeadParticles );
           _aliveParticles++;
         }
@@ -107,17 +106,17 @@ namespace prefr
 
   }
 
-  void ThrustSorter::updateParticleDistance( const tparticle_ptr current,
+  void ThrustSorter::updateParticleDistance( const ParticleRef& current,
                                              const glm::vec3& cameraPosition,
                                              bool renderDeadParticles )
   {
     DistanceUnit* dist = _distances->next( );
     CUDADistanceArray* cda = static_cast< CUDADistanceArray* >( _distances );
-    cda->translatedIDs[ _distances->current ] = current->id( );
+    cda->translatedIDs[ _distances->current ] = current.id( );
 
-    ( *_distances ).distances[ _distances->current ] =
-        current->alive( )  || renderDeadParticles ?
-        length2( current->position( ) - cameraPosition ) :
+    cda->distances[ _distances->current ] =
+        current.alive( )  || renderDeadParticles ?
+        length2( current.position( ) - cameraPosition ) :
         -1;
 
   }
@@ -44,7 +44,7 @@ namespace prefr
                                        bool renderDeadParticles = false );
 
     PREFR_API
-    virtual void updateParticleDistance( const tparticle_ptr current,
+    virtual void updateParticleDistance( const ParticleRef& current,
                                          const glm::vec3& cameraPosition,
                                          bool renderDeadParticles = false );
 
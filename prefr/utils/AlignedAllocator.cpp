@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "AlignedAllocator.h"
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace prefr
+{
+
+  static void* _defaultAllocate( size_t size, size_t alignment )
+  {
+#ifdef _WIN32
+    return _aligned_malloc( size, alignment );
+#else
+    void* result = nullptr;
+    if( posix_memalign( &result, alignment, size ) != 0 )
+      return nullptr;
+
+    return result;
+#endif
+  }
+
+  static void _defaultFree( void* pointer )
+  {
+#ifdef _WIN32
+    _aligned_free( pointer );
+#else
+    free( pointer );
+#endif
+  }
+
+  static AlignedAllocateFunction _allocate = &_defaultAllocate;
+  static AlignedFreeFunction _free = &_defaultFree;
+
+  void* alignedAllocate( size_t size, size_t alignment )
+  {
+    return _allocate( size, alignment );
+  }
+
+  void alignedFree( void* pointer )
+  {
+    if( pointer )
+      _free( pointer );
+  }
+
+  void alignedAllocation( AlignedAllocateFunction allocate,
+                          AlignedFreeFunction release )
+  {
+    _allocate = allocate ? allocate : &_defaultAllocate;
+    _free = release ? release : &_defaultFree;
+  }
+
+}
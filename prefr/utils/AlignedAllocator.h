@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __UTILS_ALIGNEDALLOCATOR__
+#define __UTILS_ALIGNEDALLOCATOR__
+
+#include <prefr/api.h>
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+
+namespace prefr
+{
+  typedef void* ( *AlignedAllocateFunction )( size_t size, size_t alignment );
+  typedef void ( *AlignedFreeFunction )( void* pointer );
+
+  /*! \brief Allocates size bytes aligned to the given power of two
+   * alignment through the current aligned allocation functions. Returns
+   * nullptr on failure.
+   */
+  PREFR_API void* alignedAllocate( size_t size, size_t alignment );
+
+  /*! \brief Releases memory obtained through alignedAllocate.
+   */
+  PREFR_API void alignedFree( void* pointer );
+
+  /*! \brief Replaces the functions used for aligned allocations.
+   *
+   * Replaces the functions used by alignedAllocate and alignedFree, and
+   * therefore by every AlignedAllocator. Memory must be released by the same
+   * functions that allocated it, so set them before creating any particle
+   * system. Passing nullptr restores the default functions.
+   *
+   * @param allocate Function allocating aligned memory.
+   * @param release Function releasing memory returned by allocate.
+   */
+  PREFR_API void alignedAllocation( AlignedAllocateFunction allocate,
+                                    AlignedFreeFunction release );
+
+  /*! \class AlignedAllocator
+   *
+   * \brief Standard allocator returning memory aligned to Alignment bytes.
+   *
+   * Allocations are padded to a multiple of Alignment bytes, so vector
+   * loads of a whole aligned block never read outside the allocation.
+   *
+   */
+  template< typename T, size_t Alignment = 64 >
+  class AlignedAllocator
+  {
+    static_assert(( Alignment & ( Alignment - 1 )) == 0 &&
+                  Alignment >= sizeof( void* ),
+                  "Alignment must be a power of two multiple of the pointer "
+                  "size." );
+
+  public:
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template< typename U >
+    struct rebind
+    {
+      typedef AlignedAllocator< U, Alignment > other;
+    };
+
+    AlignedAllocator( void )
+    { }
+
+    template< typename U >
+    AlignedAllocator( const AlignedAllocator< U, Alignment >& )
+    { }
+
+    T* allocate( size_t n, const void* = nullptr )
+    {
+      if( n > max_size( ))
+        throw std::bad_alloc( );
+
+      size_t size = ( n * sizeof( T ) + Alignment - 1 ) & ~( Alignment - 1 );
+
+      void* result = alignedAllocate( size, Alignment );
+      if( !result )
+        throw std::bad_alloc( );
+
+      return static_cast< T* >( result );
+    }
+
+    void deallocate( T* pointer_, size_t )
+    {
+      alignedFree( pointer_ );
+    }
+
+    size_t max_size( void ) const
+    {
+      return ( std::numeric_limits< size_t >::max( ) - Alignment ) /
+          sizeof( T );
+    }
+
+    template< typename U, typename... Args >
+    void construct( U* pointer_, Args&&... args )
+    {
+      ::new(( void* ) pointer_ ) U( std::forward< Args >( args )... );
+    }
+
+    template< typename U >
+    void destroy( U* pointer_ )
+    {
+      pointer_->~U( );
+    }
+
+    template< typename U >
+    bool operator==( const AlignedAllocator< U, Alignment >& ) const
+    {
+      return true;
+    }
+
+    template< typename U >
+    bool operator!=( const AlignedAllocator< U, Alignment >& ) const
+    {
+      return false;
+    }
+  };
+
+}
+
+#endif /* __UTILS_ALIGNEDALLOCATOR__ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __UTILS_FLAGSARRAY__
+#define __UTILS_FLAGSARRAY__
+
+#include "AlignedAllocator.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace prefr
+{
+
+  /*! \class FlagsArray
+   *
+   * \brief Array of per-particle boolean flags stored one byte per flag.
+   *
+   * Unlike std::vector< bool >, each flag is a separate memory location, so
+   * threads updating different particles can write their flags
+   * concurrently without synchronization, and no bit proxies are involved.
+   * Range helpers scan eight flags per step: count, findNext and fill run
+   * over whole 64-bit words, which compilers also vectorize.
+   *
+   * Flags are always stored as 0 or 1.
+   */
+  class FlagsArray
+  {
+  public:
+
+    FlagsArray( void )
+    { }
+
+    FlagsArray( size_t size_, bool value = false )
+    : _flags( size_, value )
+    { }
+
+    size_t size( void ) const
+    {
+      return _flags.size( );
+    }
+
+    bool empty( void ) const
+    {
+      return _flags.empty( );
+    }
+
+    void resize( size_t size_, bool value = false )
+    {
+      _flags.resize( size_, value );
+    }
+
+    void clear( void )
+    {
+      _flags.clear( );
+    }
+
+    bool operator[]( size_t i ) const
+    {
+      assert( i < _flags.size( ));
+      return _flags[ i ] != 0;
+    }
+
+    void set( size_t i, bool value )
+    {
+      assert( i < _flags.size( ));
+      _flags[ i ] = value;
+    }
+
+    /*! \brief Sets the flags in [ begin, end ) to the given value. */
+    void fill( size_t begin, size_t end, bool value )
+    {
+      assert( begin <= end && end <= _flags.size( ));
+
+      if( begin < end )
+        std::memset( &_flags[ begin ], value, end - begin );
+    }
+
+    /*! \brief Returns the number of flags set in [ begin, end ). */
+    size_t count( size_t begin, size_t end ) const
+    {
+      assert( begin <= end && end <= _flags.size( ));
+
+      const unsigned char* flags = _flags.data( );
+      size_t result = 0;
+
+      // Each byte is 0 or 1, so multiplying adds the eight bytes of a word
+      // into its top byte.
+      for( ; begin + sizeof( uint64_t ) <= end; begin += sizeof( uint64_t ))
+        result += ( _word( flags + begin ) * _ones( )) >> 56;
+
+      for( ; begin < end; ++begin )
+        result += flags[ begin ];
+
+      return result;
+    }
+
+    /*! \brief Returns the first position in [ begin, end ) whose flag has the
+     * given value, or end if there is none.
+     */
+    size_t findNext( size_t begin, size_t end, bool value ) const
+    {
+      assert( begin <= end && end <= _flags.size( ));
+
+      const unsigned char* flags = _flags.data( );
+      uint64_t skipped = value ? 0 : _ones( );
+
+      for( ; begin + sizeof( uint64_t ) <= end; begin += sizeof( uint64_t ))
+      {
+        if( _word( flags + begin ) != skipped )
+          break;
+      }
+
+      for( ; begin < end; ++begin )
+      {
+        if(( flags[ begin ] != 0 ) == value )
+          return begin;
+      }
+
+      return end;
+    }
+
+    const unsigned char* data( void ) const
+    {
+      return _flags.data( );
+    }
+
+  protected:
+
+    /*! Word with every byte set to 1. */
+    static uint64_t _ones( void )
+    {
+      return 0x0101010101010101ull;
+    }
+
+    static uint64_t _word( const unsigned char* flags )
+    {
+      uint64_t word;
+      std::memcpy( &word, flags, sizeof( word ));
+      return word;
+    }
+
+    std::vector< unsigned char, AlignedAllocator< unsigned char >> _flags;
+  };
+
+}
+
+#endif /* __UTILS_FLAGSARRAY__ */
@@ -52,7 +52,25 @@ namespace utils
 
     unsigned int size;
 
-    InterpolationSet( void ): step( 1 ), size( 0 ){ }
+    /*! Curve sampled at lookupTableSize + 1 evenly spaced times in [0, 1],
+     * rebuilt by Bake when the curve has changed. */
+    std::vector< T > lookupTable;
+    unsigned int lookupTableSize;
+
+    /*! True when keyframes changed after the last Bake call. */
+    bool dirty;
+
+    /*! Number of times Bake rebuilt the lookup table, so that copies of the
+     * table can tell when it changed. */
+    unsigned int bakes;
+
+    /*! Intervals of the lookup table unless changed by SetLookupTableSize.
+     */
+    static const unsigned int defaultLookupTableSize = 256;
+
+    InterpolationSet( void )
+    : step( 1 ), size( 0 ), lookupTableSize( defaultLookupTableSize )
+    , dirty( true ), bakes( 0 ){ }
 
   public:
 
@@ -60,6 +78,8 @@ namespace utils
     {
       assert( time >= 0 && time <= 1.0f );
 
+      dirty = true;
+
       unsigned int i = 0;
       unsigned int precision;
 
@@ -108,8 +128,10 @@ namespace utils
       precisionValues.clear( );
       quickReference.clear( );
       invIntervals.clear( );
+      lookupTable.clear( );
       step = 0;
       size = 0;
+      dirty = true;
 
     }
 
@@ -118,6 +140,8 @@ namespace utils
       if( i >= size || size == 1 )
         return;
 
+      dirty = true;
+
       times.erase( times.begin( ) + i );
       values.erase( values.begin( ) + i );
       precisionValues.erase( precisionValues.begin( ) + i );
@@ -183,6 +207,94 @@ namespace utils
       }
     }
 
+    // Sets the number of intervals of the lookup table.
+    inline void SetLookupTableSize( unsigned int newSize )
+    {
+      assert( newSize > 0 );
+
+      if( newSize == lookupTableSize )
+        return;
+
+      lookupTableSize = newSize;
+      dirty = true;
+    }
+
+    // Rebuilds the lookup table if keyframes changed. Not thread safe, so
+    // call it before evaluating the curve from several threads.
+    inline void Bake( void )
+    {
+      if( !dirty )
+        return;
+
+      lookupTable.clear( );
+
+      if( size > 0 )
+      {
+        lookupTable.resize( lookupTableSize + 1 );
+
+        unsigned int i = 0;
+        for( unsigned int j = 0; j <= lookupTableSize; j++ )
+        {
+          float time = float( j ) / lookupTableSize;
+
+          if( size == 1 )
+          {
+            lookupTable[ j ] = values[ 0 ];
+            continue;
+          }
+
+          while( i + 2 < size && time > times[ i + 1 ])
+            i++;
+
+          float relTime = glm::clamp(( time - times[ i ]) * invIntervals[ i ],
+                                     0.f, 1.f );
+
+          lookupTable[ j ] =
+              ( 1.0f - relTime ) * values[ i ] + relTime * values[ i + 1 ];
+        }
+      }
+
+      dirty = false;
+      ++bakes;
+    }
+
+    // Constant time interpolation over the lookup table. Falls back to
+    // GetValue if the curve has not been baked since it last changed.
+    // Curves without keyframes evaluate to T( ).
+    inline T GetLookupValue( float time )
+    {
+      if( size == 0 )
+        return T( );
+
+      if( dirty )
+        return GetValue( time );
+
+      float position = glm::clamp( time, 0.0f, 1.0f ) * lookupTableSize;
+      unsigned int i = std::min(( unsigned int ) position, lookupTableSize - 1 );
+      float relTime = position - i;
+
+      return ( 1.0f - relTime ) * lookupTable[ i ] +
+             relTime * lookupTable[ i + 1 ];
+    }
+
+    // Evaluates the curve at count times, writing out[ 0 ] to
+    // out[ count - 1 ]. OutputIterator must support out[ i ] = T.
+    template< class OutputIterator >
+    inline void GetValues( const float* times_, OutputIterator out,
+                           unsigned int count )
+    {
+      if( dirty && size > 0 )
+      {
+        for( unsigned int i = 0; i < count; i++ )
+          out[ i ] = GetValue( times_[ i ]);
+
+        return;
+      }
+
+      for( unsigned int i = 0; i < count; i++ )
+        out[ i ] = GetLookupValue( times_[ i ]);
+    }
+
   private:
 
     unsigned int GetMaxPrecision( )
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "RadixSort.h"
+#include "../core/DistanceArray.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef PREFR_USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace prefr
+{
+  namespace radix
+  {
+    static const unsigned int digitBits = 11;
+    static const unsigned int buckets = 1 << digitBits;
+    static const unsigned int passes = ( 32 + digitBits - 1 ) / digitBits;
+
+    /*! Minimum number of units sorted in parallel. */
+    static const unsigned int parallelSize = 1 << 16;
+
+    // Keys are complemented so that ascending keys are descending
+    // distances.
+    static inline uint32_t _key( const DistanceUnit& unit )
+    {
+      return ~floatKey( unit.distance( ));
+    }
+
+    static inline unsigned int _digit( uint32_t key, unsigned int pass )
+    {
+      return ( key >> ( pass * digitBits )) & ( buckets - 1 );
+    }
+
+    static void _sortSerial( DistanceUnit* units, DistanceUnit* scratch,
+                             unsigned int size )
+    {
+      // Histograms of every pass are computed in a single read.
+      std::vector< unsigned int > histograms( passes * buckets, 0 );
+      for( unsigned int i = 0; i < size; ++i )
+      {
+        uint32_t key = _key( units[ i ]);
+
+        for( unsigned int pass = 0; pass < passes; ++pass )
+          ++histograms[ pass * buckets + _digit( key, pass )];
+      }
+
+      DistanceUnit* source = units;
+      DistanceUnit* destination = scratch;
+
+      for( unsigned int pass = 0; pass < passes; ++pass )
+      {
+        unsigned int* offsets = &histograms[ pass * buckets ];
+
+        if( offsets[ _digit( _key( source[ 0 ]), pass )] == size )
+          continue;
+
+        unsigned int sum = 0;
+        for( unsigned int b = 0; b < buckets; ++b )
+        {
+          unsigned int count = offsets[ b ];
+          offsets[ b ] = sum;
+          sum += count;
+        }
+
+        for( unsigned int i = 0; i < size; ++i )
+        {
+          const DistanceUnit& unit = source[ i ];
+          destination[ offsets[ _digit( _key( unit ), pass )]++ ] = unit;
+        }
+
+        std::swap( source, destination );
+      }
+
+      if( source != units )
+        std::copy( source, source + size, units );
+    }
+
+#ifdef PREFR_USE_OPENMP
+
+    static void _sortParallel( DistanceUnit* units, DistanceUnit* scratch,
+                               unsigned int size )
+    {
+      unsigned int threads = omp_get_max_threads( );
+      unsigned int chunk = ( size + threads - 1 ) / threads;
+
+      // Histograms of each chunk, turned into the write offsets of each
+      // chunk and digit. Chunks are processed by different threads.
+      std::vector< unsigned int > offsets( threads * buckets );
+
+      DistanceUnit* source = units;
+      DistanceUnit* destination = scratch;
+
+      for( unsigned int pass = 0; pass < passes; ++pass )
+      {
+        #pragma omp parallel for num_threads( threads ) schedule( static, 1 )
+        for( int thread = 0; thread < ( int ) threads; ++thread )
+        {
+          unsigned int begin = std::min( size, thread * chunk );
+          unsigned int end = std::min( size, begin + chunk );
+
+          unsigned int* histogram = &offsets[ thread * buckets ];
+          std::fill( histogram, histogram + buckets, 0 );
+
+          for( unsigned int i = begin; i < end; ++i )
+            ++histogram[ _digit( _key( source[ i ]), pass )];
+        }
+
+        // Skip the pass if every unit shares the same digit.
+        unsigned int digit = _digit( _key( source[ 0 ]), pass );
+        unsigned int shared = 0;
+        for( unsigned int t = 0; t < threads; ++t )
+          shared += offsets[ t * buckets + digit ];
+
+        if( shared == size )
+          continue;
+
+        // Chunk t writes digit b after every unit with a lower digit and
+        // after the units of digit b of previous chunks, keeping stability.
+        unsigned int sum = 0;
+        for( unsigned int b = 0; b < buckets; ++b )
+        {
+          for( unsigned int t = 0; t < threads; ++t )
+          {
+            unsigned int count = offsets[ t * buckets + b ];
+            offsets[ t * buckets + b ] = sum;
+            sum += count;
+          }
+        }
+
+        #pragma omp parallel for num_threads( threads ) schedule( static, 1 )
+        for( int thread = 0; thread < ( int ) threads; ++thread )
+        {
+          unsigned int begin = std::min( size, thread * chunk );
+          unsigned int end = std::min( size, begin + chunk );
+
+          unsigned int* offset = &offsets[ thread * buckets ];
+
+          for( unsigned int i = begin; i < end; ++i )
+          {
+            const DistanceUnit& unit = source[ i ];
+            destination[ offset[ _digit( _key( unit ), pass )]++ ] = unit;
+          }
+        }
+
+        std::swap( source, destination );
+      }
+
+      if( source != units )
+        std::copy( source, source + size, units );
+    }
+
+#endif
+
+    void sortDescending( DistanceUnit* units, DistanceUnit* scratch,
+                         unsigned int size, bool parallel )
+    {
+      if( size < 2 )
+        return;
+
+#ifdef PREFR_USE_OPENMP
+      if( parallel && size >= parallelSize && omp_get_max_threads( ) > 1 )
+      {
+        _sortParallel( units, scratch, size );
+        return;
+      }
+#else
+      ( void ) parallel;
+#endif
+
+      _sortSerial( units, scratch, size );
+    }
+  }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __PREFR_RADIXSORT__
+#define __PREFR_RADIXSORT__
+
+#include <prefr/api.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace prefr
+{
+  class DistanceUnit;
+
+  /*! \namespace radix
+   *
+   * \brief LSD radix sort of distance units.
+   *
+   * Units are sorted in place by their distance, moving id and distance
+   * together. Float distances are mapped to unsigned keys keeping their
+   * order, and sorted in 11-bit digits.
+   */
+  namespace radix
+  {
+    /*! \brief Maps a float to an unsigned key with the same ascending
+     * order. */
+    inline uint32_t floatKey( float value )
+    {
+      uint32_t bits;
+      std::memcpy( &bits, &value, sizeof( bits ));
+
+      return bits ^ (( bits >> 31 ) ? 0xFFFFFFFFu : 0x80000000u );
+    }
+
+    /*! \brief Sorts units by descending distance.
+     *
+     * Stable LSD radix sort on the distance bits, computing keys on the fly
+     * so no key array is built. Passes whose digit is shared by every key
+     * are skipped. When parallel is true and the library is built with
+     * OpenMP, large arrays are sorted with one histogram per thread.
+     *
+     * @param units Units to be sorted.
+     * @param scratch Buffer with room for size units.
+     * @param size Number of units.
+     * @param parallel true to use every OpenMP thread.
+     */
+    PREFR_API void sortDescending( DistanceUnit* units, DistanceUnit* scratch,
+                                   unsigned int size, bool parallel = false );
+  }
+}
+
+#endif /* __PREFR_RADIXSORT__ */
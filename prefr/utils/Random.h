@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __UTILS_RANDOM__
+#define __UTILS_RANDOM__
+
+#include <cstdint>
+
+namespace prefr
+{
+
+  /*! \brief Philox4x32-10 counter-based generator.
+   *
+   * Returns in result four random words computed from the given counter and
+   * key. The result only depends on its inputs, so streams do not need any
+   * shared state and can be generated from any thread in any order.
+   */
+  inline void philox( const uint32_t* counter, const uint32_t* key,
+                      uint32_t* result )
+  {
+    uint32_t c0 = counter[ 0 ], c1 = counter[ 1 ];
+    uint32_t c2 = counter[ 2 ], c3 = counter[ 3 ];
+    uint32_t k0 = key[ 0 ], k1 = key[ 1 ];
+
+    for( unsigned int round = 0; round < 10; ++round )
+    {
+      uint64_t p0 = uint64_t( 0xD2511F53u ) * c0;
+      uint64_t p1 = uint64_t( 0xCD9E8D57u ) * c2;
+
+      uint32_t n0 = uint32_t( p1 >> 32 ) ^ c1 ^ k0;
+      uint32_t n1 = uint32_t( p1 );
+      uint32_t n2 = uint32_t( p0 >> 32 ) ^ c3 ^ k1;
+      uint32_t n3 = uint32_t( p0 );
+
+      c0 = n0; c1 = n1; c2 = n2; c3 = n3;
+
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+
+    result[ 0 ] = c0;
+    result[ 1 ] = c1;
+    result[ 2 ] = c2;
+    result[ 3 ] = c3;
+  }
+
+  /*! \brief Maps a random word to a float uniformly distributed in [0, 1).
+   */
+  inline float unitFloat( uint32_t value )
+  {
+    return ( value >> 8 ) * ( 1.0f / 16777216.0f );
+  }
+
+  /*! \class RandomStream
+   *
+   * \brief Sequence of random numbers of a single particle.
+   *
+   * Generates the numbers of the stream identified by seed, particle id,
+   * frame and stream index, four at a time. Two streams with the same
+   * identifiers return the same sequence, regardless of the thread and the
+   * order in which they are used.
+   *
+   * @see RandomContext
+   */
+  class RandomStream
+  {
+  public:
+
+    RandomStream( uint32_t seed = 0, uint32_t id = 0,
+                  uint32_t frame = 0, uint32_t stream = 0 )
+    : _available( 0 )
+    {
+      _key[ 0 ] = id;
+      _key[ 1 ] = seed;
+
+      _counter[ 0 ] = frame;
+      _counter[ 1 ] = stream;
+      _counter[ 2 ] = 0;
+      _counter[ 3 ] = 0;
+    }
+
+    /*! \brief Returns the next random word of the stream. */
+    uint32_t next( void )
+    {
+      if( _available == 0 )
+      {
+        philox( _counter, _key, _buffer );
+        ++_counter[ 2 ];
+        _available = 4;
+      }
+
+      return _buffer[ 4 - _available-- ];
+    }
+
+    /*! \brief Returns the next random float of the stream in [0, 1). */
+    float uniform( void )
+    {
+      return unitFloat( next( ));
+    }
+
+    /*! \brief Stores the next count random floats of the stream in [0, 1).
+     */
+    void uniform( float* result, unsigned int count )
+    {
+      for( unsigned int i = 0; i < count; ++i )
+        result[ i ] = uniform( );
+    }
+
+  protected:
+
+    uint32_t _key[ 2 ];
+    uint32_t _counter[ 4 ];
+    uint32_t _buffer[ 4 ];
+    unsigned int _available;
+  };
+
+  /*! \class RandomContext
+   *
+   * \brief Per-frame random number context shared by updaters and samplers.
+   *
+   * Identifies the random streams of the current frame. Numbers depend on
+   * the seed, the particle id and the frame only, so no lock is taken when
+   * generating them. Particles are emitted at most once per frame, so the
+   * frame counter also identifies each emission of a particle. Along with
+   * the fixed emission order of Source, this makes seeded simulations
+   * reproducible regardless of the number of threads.
+   *
+   * Streams used by the library:
+   *   - lifeStream: initial life of emitted particles.
+   *   - sampleStream: values generated by Sampler objects.
+   */
+  class RandomContext
+  {
+  public:
+
+    static const uint32_t lifeStream = 0;
+    static const uint32_t sampleStream = 1;
+
+    RandomContext( uint32_t seed_ = 0 )
+    : _seed( seed_ )
+    , _frame( 0 )
+    { }
+
+    uint32_t seed( void ) const
+    {
+      return _seed;
+    }
+
+    void seed( uint32_t seed_ )
+    {
+      _seed = seed_;
+      _frame = 0;
+    }
+
+    uint32_t frame( void ) const
+    {
+      return _frame;
+    }
+
+    void nextFrame( void )
+    {
+      ++_frame;
+    }
+
+    /*! \brief Returns the stream of the given particle for the current
+     * frame. */
+    RandomStream stream( uint32_t id, uint32_t stream_ ) const
+    {
+      return RandomStream( _seed, id, _frame, stream_ );
+    }
+
+    /*! \brief Returns the first value of the given stream of a particle for
+     * the current frame, in [0, 1). */
+    float uniform( uint32_t id, uint32_t stream_ ) const
+    {
+      return stream( id, stream_ ).uniform( );
+    }
+
+    /*! \brief Stores in result the first value of the given stream of each
+     * particle id, in [0, 1).
+     *
+     * Streams are independent, so the loop has no dependencies between
+     * iterations and is vectorized by the compiler.
+     */
+    void uniform( const uint32_t* ids, float* result, unsigned int count,
+                  uint32_t stream_ ) const
+    {
+      uniform( ids, &result, 1, count, stream_ );
+    }
+
+    /*! \brief Stores in results[ v ] the v-th value of the given stream of
+     * each particle id, in [0, 1), for the first values (up to 4) of each
+     * stream. Values match the ones returned by RandomStream::uniform.
+     */
+    void uniform( const uint32_t* ids, float* const* results,
+                  unsigned int values, unsigned int count,
+                  uint32_t stream_ ) const
+    {
+      uint32_t counter[ 4 ] = { _frame, stream_, 0, 0 };
+
+      for( unsigned int i = 0; i < count; ++i )
+      {
+        uint32_t key[ 2 ] = { ids[ i ], _seed };
+        uint32_t words[ 4 ];
+
+        philox( counter, key, words );
+
+        for( unsigned int v = 0; v < values; ++v )
+          results[ v ][ i ] = unitFloat( words[ v ]);
+      }
+    }
+
+  protected:
+
+    uint32_t _seed;
+    uint32_t _frame;
+  };
+
+}
+
+#endif /* __UTILS_RANDOM__ */
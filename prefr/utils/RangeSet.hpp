@@ -0,0 +1,1003 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __UTILS_RANGESET__
+#define __UTILS_RANGESET__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <set>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace prefr
+{
+
+  /*! \brief Half-open interval [begin, end) of consecutive indices. */
+  class IndexSpan
+  {
+  public:
+
+    IndexSpan( void )
+    : begin( 0 )
+    , end( 0 )
+    { }
+
+    IndexSpan( unsigned int begin_, unsigned int end_ )
+    : begin( begin_ )
+    , end( end_ )
+    { }
+
+    unsigned int size( void ) const { return end - begin; }
+
+    unsigned int begin;
+    unsigned int end;
+  };
+
+  typedef std::vector< IndexSpan > IndexSpans;
+
+  /*! \class RangeSet
+   *
+   * \brief Compressed set of unsigned indices.
+   *
+   * The index space is split into chunks of 2^16 elements, following the
+   * Roaring bitmaps layout. Each chunk stores its elements as a sorted list
+   * of runs and switches to a plain bitmap once the number of runs makes the
+   * bitmap the smaller representation. A contiguous block of indices costs
+   * a single run per chunk regardless of its length.
+   *
+   * Elements are always visited in ascending order. Consumers should prefer
+   * iterating through spans of consecutive indices (see forEachSpan), so
+   * that inner loops run over raw ranges. Element iterators and positional
+   * access are provided for compatibility, the latter being linear on the
+   * number of runs of the affected chunk.
+   *
+   * Inserting or removing a single element takes a binary search over
+   * chunks and runs. Run chunks then shift their later runs, while bitmap
+   * chunks take constant time. Insertions and removals leaving more than
+   * MAX_RUNS runs turn the chunk into a bitmap, so shifts stay under 8KB
+   * and the cost does not grow with the number of elements. Inserting or
+   * removing intervals costs the same per chunk they cover.
+   *
+   * Note: a bitmap chunk is turned back into runs only when it gets full.
+   *
+   */
+  class RangeSet
+  {
+
+  protected:
+
+    static const unsigned int CHUNK_BITS = 16;
+    static const unsigned int CHUNK_SIZE = 1u << CHUNK_BITS;
+    static const unsigned int CHUNK_MASK = CHUNK_SIZE - 1;
+    static const unsigned int BITMAP_WORDS = CHUNK_SIZE / 64;
+
+    // Runs beyond this count take more memory than a bitmap.
+    static const unsigned int MAX_RUNS = BITMAP_WORDS * 8 / 4;
+
+    // Inclusive run [start, last] local to a chunk.
+    class Run
+    {
+    public:
+      Run( uint16_t start_, uint16_t last_ )
+      : start( start_ )
+      , last( last_ )
+      { }
+
+      uint16_t start;
+      uint16_t last;
+    };
+
+    class Chunk
+    {
+    public:
+
+      Chunk( unsigned int key_ )
+      : key( key_ )
+      , cardinality( 0 )
+      { }
+
+      bool isBitmap( void ) const { return !bitmap.empty( ); }
+
+      unsigned int base( void ) const { return key << CHUNK_BITS; }
+
+      unsigned int key;
+      unsigned int cardinality;
+      std::vector< Run > runs;
+      std::vector< uint64_t > bitmap;
+    };
+
+  public:
+
+    /*! \brief Bidirectional iterator visiting elements in ascending order. */
+    class const_iterator
+    {
+      friend class RangeSet;
+
+    public:
+
+      typedef std::bidirectional_iterator_tag iterator_category;
+      typedef unsigned int value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const unsigned int* pointer;
+      typedef const unsigned int& reference;
+
+      const_iterator( void )
+      : _set( nullptr )
+      , _chunk( 0 )
+      , _run( 0 )
+      , _value( 0 )
+      { }
+
+      reference operator*( void ) const { return _value; }
+      pointer operator->( void ) const { return &_value; }
+
+      const_iterator& operator++( void )
+      {
+        _set->_next( *this );
+        return *this;
+      }
+
+      const_iterator operator++( int )
+      {
+        const_iterator result( *this );
+        _set->_next( *this );
+        return result;
+      }
+
+      const_iterator& operator--( void )
+      {
+        _set->_previous( *this );
+        return *this;
+      }
+
+      const_iterator operator--( int )
+      {
+        const_iterator result( *this );
+        _set->_previous( *this );
+        return result;
+      }
+
+      bool operator==( const const_iterator& other ) const
+      {
+        return _set == other._set && _chunk == other._chunk &&
+               _value == other._value;
+      }
+
+      bool operator!=( const const_iterator& other ) const
+      {
+        return !( *this == other );
+      }
+
+    protected:
+
+      const RangeSet* _set;
+      unsigned int _chunk;
+      unsigned int _run;
+      unsigned int _value;
+    };
+
+    RangeSet( void )
+    : _size( 0 )
+    { }
+
+    RangeSet( const std::vector< unsigned int >& elements )
+    : _size( 0 )
+    {
+      insert( elements );
+    }
+
+    RangeSet( const std::set< unsigned int >& elements )
+    : _size( 0 )
+    {
+      insert( elements );
+    }
+
+    RangeSet( std::initializer_list< unsigned int > initializer )
+    : _size( 0 )
+    {
+      for( auto element : initializer )
+        insert( element );
+    }
+
+    size_t size( void ) const
+    {
+      return _size;
+    }
+
+    bool empty( void ) const
+    {
+      return _size == 0;
+    }
+
+    void clear( void )
+    {
+      _chunks.clear( );
+      _size = 0;
+    }
+
+    /*! \brief Returns the approximate number of bytes used by the set. */
+    size_t memoryUsage( void ) const
+    {
+      size_t result = sizeof( RangeSet ) + _chunks.capacity( ) * sizeof( Chunk );
+      for( auto const& chunk : _chunks )
+      {
+        result += chunk.runs.capacity( ) * sizeof( Run );
+        result += chunk.bitmap.capacity( ) * sizeof( uint64_t );
+      }
+      return result;
+    }
+
+    std::set< unsigned int > set( void ) const
+    {
+      return std::set< unsigned int >( begin( ), end( ));
+    }
+
+    std::vector< unsigned int > vector( void ) const
+    {
+      std::vector< unsigned int > result;
+      result.reserve( _size );
+      forEachSpan( [ &result ]( unsigned int begin_, unsigned int end_ )
+      {
+        for( unsigned int v = begin_; v < end_; ++v )
+          result.push_back( v );
+      });
+      return result;
+    }
+
+    bool hasElement( unsigned int value ) const
+    {
+      const Chunk* chunk = _findChunk( value >> CHUNK_BITS );
+      if( !chunk )
+        return false;
+
+      uint16_t low = uint16_t( value & CHUNK_MASK );
+
+      if( chunk->isBitmap( ))
+        return ( chunk->bitmap[ low >> 6 ] >> ( low & 63 )) & 1;
+
+      auto it = _runAfter( *chunk, low );
+      return it != chunk->runs.begin( ) && ( --it )->last >= low;
+    }
+
+    const_iterator begin( void ) const
+    {
+      const_iterator result;
+      result._set = this;
+      _first( result, 0 );
+      return result;
+    }
+
+    const_iterator end( void ) const
+    {
+      const_iterator result;
+      result._set = this;
+      result._chunk = unsigned( _chunks.size( ));
+      return result;
+    }
+
+    /*! \brief Returns the highest element. The set must not be empty. */
+    unsigned int back( void ) const
+    {
+      return *( --end( ));
+    }
+
+    const_iterator find( unsigned int value ) const
+    {
+      if( !hasElement( value ))
+        return end( );
+
+      unsigned int key = value >> CHUNK_BITS;
+      auto chunk = std::lower_bound( _chunks.begin( ), _chunks.end( ), key,
+                                     []( const Chunk& c, unsigned int k )
+                                     { return c.key < k; });
+
+      const_iterator result;
+      result._set = this;
+      result._chunk = unsigned( chunk - _chunks.begin( ));
+      result._value = value;
+
+      if( !chunk->isBitmap( ))
+        result._run = unsigned(
+            _runAfter( *chunk, uint16_t( value & CHUNK_MASK )) -
+            chunk->runs.begin( )) - 1;
+
+      return result;
+    }
+
+    /*! \brief Returns the number of elements lower than the given value. */
+    size_t rank( unsigned int value ) const
+    {
+      unsigned int key = value >> CHUNK_BITS;
+      unsigned int low = value & CHUNK_MASK;
+
+      size_t result = 0;
+      for( auto const& chunk : _chunks )
+      {
+        if( chunk.key > key )
+          break;
+
+        if( chunk.key < key )
+        {
+          result += chunk.cardinality;
+          continue;
+        }
+
+        if( chunk.isBitmap( ))
+        {
+          for( unsigned int w = 0; w < ( low >> 6 ); ++w )
+            result += _popCount( chunk.bitmap[ w ]);
+
+          uint64_t partial = ( uint64_t( 1 ) << ( low & 63 )) - 1;
+          result += _popCount( chunk.bitmap[ low >> 6 ] & partial );
+        }
+        else
+        {
+          for( auto const& run : chunk.runs )
+          {
+            if( run.start >= low )
+              break;
+            result += std::min< unsigned int >( run.last + 1u, low ) -
+                      run.start;
+          }
+        }
+        break;
+      }
+
+      return result;
+    }
+
+    /*! \brief Returns an iterator to the element at the given position in
+     * ascending order, or end( ) if out of range.
+     */
+    const_iterator at( size_t position ) const
+    {
+      if( position >= _size )
+        return end( );
+
+      const_iterator result;
+      result._set = this;
+
+      for( auto const& chunk : _chunks )
+      {
+        if( position >= chunk.cardinality )
+        {
+          position -= chunk.cardinality;
+          ++result._chunk;
+          continue;
+        }
+
+        if( chunk.isBitmap( ))
+        {
+          for( unsigned int w = 0; w < BITMAP_WORDS; ++w )
+          {
+            uint64_t word = chunk.bitmap[ w ];
+            unsigned int count = _popCount( word );
+            if( position >= count )
+            {
+              position -= count;
+              continue;
+            }
+
+            for( ; position > 0; --position )
+              word &= word - 1;
+
+            result._value = chunk.base( ) + ( w << 6 ) +
+                            _countTrailingZeros( word );
+            break;
+          }
+        }
+        else
+        {
+          for( auto const& run : chunk.runs )
+          {
+            size_t length = size_t( run.last - run.start ) + 1;
+            if( position >= length )
+            {
+              position -= length;
+              ++result._run;
+              continue;
+            }
+
+            result._value = chunk.base( ) + run.start + unsigned( position );
+            break;
+          }
+        }
+        break;
+      }
+
+      return result;
+    }
+
+    bool insert( unsigned int value )
+    {
+      size_t previous = _size;
+      _insertLocal( _chunk( value >> CHUNK_BITS ), uint16_t( value & CHUNK_MASK ),
+                    uint16_t( value & CHUNK_MASK ));
+      return _size != previous;
+    }
+
+    bool push_back( unsigned int element ){ return insert( element ); }
+    bool append( unsigned int element ){ return insert( element ); }
+
+    /*! \brief Inserts the half-open interval [begin_, end_). */
+    void insert( unsigned int begin_, unsigned int end_ )
+    {
+      while( begin_ < end_ )
+      {
+        unsigned int key = begin_ >> CHUNK_BITS;
+        unsigned int chunkEnd = _chunkEnd( key, end_ );
+
+        _insertLocal( _chunk( key ), uint16_t( begin_ & CHUNK_MASK ),
+                      uint16_t(( chunkEnd - 1 ) & CHUNK_MASK ));
+
+        begin_ = chunkEnd;
+      }
+    }
+
+    void insert( const std::vector< unsigned int >& elements )
+    {
+      // Coalesce consecutive elements so contiguous input becomes a few runs.
+      size_t i = 0;
+      while( i < elements.size( ))
+      {
+        size_t j = i + 1;
+        while( j < elements.size( ) && elements[ j ] == elements[ j - 1 ] + 1 )
+          ++j;
+
+        insert( elements[ i ], elements[ j - 1 ] + 1 );
+
+        i = j;
+      }
+    }
+
+    void insert( const std::set< unsigned int >& elements )
+    {
+      for( auto element : elements )
+        insert( element );
+    }
+
+    void insert( const RangeSet& other )
+    {
+      if( &other == this )
+        return;
+
+      other.forEachSpan( [ this ]( unsigned int begin_, unsigned int end_ )
+      {
+        insert( begin_, end_ );
+      });
+    }
+
+    bool remove( unsigned int value )
+    {
+      size_t previous = _size;
+      _removeFromChunk( value >> CHUNK_BITS, uint16_t( value & CHUNK_MASK ),
+                        uint16_t( value & CHUNK_MASK ));
+      return _size != previous;
+    }
+
+    /*! \brief Removes the half-open interval [begin_, end_). */
+    void remove( unsigned int begin_, unsigned int end_ )
+    {
+      while( begin_ < end_ )
+      {
+        unsigned int key = begin_ >> CHUNK_BITS;
+        unsigned int chunkEnd = _chunkEnd( key, end_ );
+
+        _removeFromChunk( key, uint16_t( begin_ & CHUNK_MASK ),
+                          uint16_t(( chunkEnd - 1 ) & CHUNK_MASK ));
+
+        begin_ = chunkEnd;
+      }
+    }
+
+    void remove( const std::vector< unsigned int >& elements )
+    {
+      for( auto element : elements )
+        remove( element );
+    }
+
+    void remove( const std::set< unsigned int >& elements )
+    {
+      for( auto element : elements )
+        remove( element );
+    }
+
+    void remove( const RangeSet& other )
+    {
+      if( &other == this )
+      {
+        clear( );
+        return;
+      }
+
+      other.forEachSpan( [ this ]( unsigned int begin_, unsigned int end_ )
+      {
+        remove( begin_, end_ );
+      });
+    }
+
+    /*! \brief Calls f( begin, end ) for every maximal run of consecutive
+     * indices, in ascending order.
+     */
+    template< typename F >
+    void forEachSpan( F f ) const
+    {
+      bool open = false;
+      unsigned int spanBegin = 0;
+      unsigned int spanEnd = 0;
+
+      auto emit = [ & ]( unsigned int begin_, unsigned int end_ )
+      {
+        if( open && begin_ == spanEnd )
+        {
+          spanEnd = end_;
+          return;
+        }
+
+        if( open )
+          f( spanBegin, spanEnd );
+
+        open = true;
+        spanBegin = begin_;
+        spanEnd = end_;
+      };
+
+      for( auto const& chunk : _chunks )
+      {
+        unsigned int base = chunk.base( );
+
+        if( !chunk.isBitmap( ))
+        {
+          for( auto const& run : chunk.runs )
+            emit( base + run.start, base + run.last + 1 );
+          continue;
+        }
+
+        unsigned int pos = 0;
+        while( pos < CHUNK_SIZE )
+        {
+          unsigned int first = _scan( chunk.bitmap, pos, true );
+          if( first >= CHUNK_SIZE )
+            break;
+          unsigned int last = _scan( chunk.bitmap, first, false );
+          emit( base + first, base + last );
+          pos = last;
+        }
+      }
+
+      if( open )
+        f( spanBegin, spanEnd );
+    }
+
+    IndexSpans spans( void ) const
+    {
+      IndexSpans result;
+      forEachSpan( [ &result ]( unsigned int begin_, unsigned int end_ )
+      {
+        result.emplace_back( begin_, end_ );
+      });
+      return result;
+    }
+
+    /*! \brief Returns the spans of consecutive indices, splitting those
+     * longer than maxLength. Useful to balance parallel loops.
+     */
+    IndexSpans spans( unsigned int maxLength ) const
+    {
+      IndexSpans result;
+      forEachSpan( [ &result, maxLength ]( unsigned int begin_,
+                                           unsigned int end_ )
+      {
+        for( ; end_ - begin_ > maxLength; begin_ += maxLength )
+          result.emplace_back( begin_, begin_ + maxLength );
+
+        result.emplace_back( begin_, end_ );
+      });
+      return result;
+    }
+
+  protected:
+
+    const Chunk* _findChunk( unsigned int key ) const
+    {
+      auto it = std::lower_bound( _chunks.begin( ), _chunks.end( ), key,
+                                  []( const Chunk& c, unsigned int k )
+                                  { return c.key < k; });
+
+      return it != _chunks.end( ) && it->key == key ? &( *it ) : nullptr;
+    }
+
+    Chunk* _findChunk( unsigned int key )
+    {
+      return const_cast< Chunk* >(
+          static_cast< const RangeSet* >( this )->_findChunk( key ));
+    }
+
+    Chunk& _chunk( unsigned int key )
+    {
+      auto it = std::lower_bound( _chunks.begin( ), _chunks.end( ), key,
+                                  []( const Chunk& c, unsigned int k )
+                                  { return c.key < k; });
+
+      if( it == _chunks.end( ) || it->key != key )
+        it = _chunks.insert( it, Chunk( key ));
+
+      return *it;
+    }
+
+    // End of the given interval clamped to the limit of the key's chunk.
+    static unsigned int _chunkEnd( unsigned int key, unsigned int end_ )
+    {
+      uint64_t chunkLimit = ( uint64_t( key ) + 1 ) << CHUNK_BITS;
+      return unsigned( std::min< uint64_t >( end_, chunkLimit ));
+    }
+
+    // First run whose start is greater than the given value.
+    static std::vector< Run >::const_iterator
+    _runAfter( const Chunk& chunk, uint16_t value )
+    {
+      return std::upper_bound( chunk.runs.begin( ), chunk.runs.end( ), value,
+                               []( uint16_t v, const Run& r )
+                               { return v < r.start; });
+    }
+
+    static std::vector< Run >::iterator
+    _runAfter( Chunk& chunk, uint16_t value )
+    {
+      return std::upper_bound( chunk.runs.begin( ), chunk.runs.end( ), value,
+                               []( uint16_t v, const Run& r )
+                               { return v < r.start; });
+    }
+
+    // Position of the first bit equal to 'value' at or after 'pos'.
+    static unsigned int _scan( const std::vector< uint64_t >& bitmap,
+                               unsigned int pos, bool value )
+    {
+      unsigned int word = pos >> 6;
+      uint64_t bits = value ? bitmap[ word ] : ~bitmap[ word ];
+      bits &= ~uint64_t( 0 ) << ( pos & 63 );
+
+      while( !bits )
+      {
+        if( ++word == BITMAP_WORDS )
+          return CHUNK_SIZE;
+        bits = value ? bitmap[ word ] : ~bitmap[ word ];
+      }
+
+      return ( word << 6 ) + _countTrailingZeros( bits );
+    }
+
+    // Position of the last set bit at or before 'pos', CHUNK_SIZE if none.
+    static unsigned int _scanBackward( const std::vector< uint64_t >& bitmap,
+                                       unsigned int pos )
+    {
+      unsigned int word = pos >> 6;
+      uint64_t bits = bitmap[ word ];
+      if(( pos & 63 ) != 63 )
+        bits &= ( uint64_t( 1 ) << (( pos & 63 ) + 1 )) - 1;
+
+      while( !bits )
+      {
+        if( word-- == 0 )
+          return CHUNK_SIZE;
+        bits = bitmap[ word ];
+      }
+
+      return ( word << 6 ) + 63 - _countLeadingZeros( bits );
+    }
+
+    static unsigned int _countTrailingZeros( uint64_t bits )
+    {
+#ifdef _MSC_VER
+      unsigned long result;
+      _BitScanForward64( &result, bits );
+      return unsigned( result );
+#else
+      return unsigned( __builtin_ctzll( bits ));
+#endif
+    }
+
+    static unsigned int _countLeadingZeros( uint64_t bits )
+    {
+#ifdef _MSC_VER
+      unsigned long result;
+      _BitScanReverse64( &result, bits );
+      return 63 - unsigned( result );
+#else
+      return unsigned( __builtin_clzll( bits ));
+#endif
+    }
+
+    static unsigned int _popCount( uint64_t bits )
+    {
+#ifdef _MSC_VER
+      return unsigned( __popcnt64( bits ));
+#else
+      return unsigned( __builtin_popcountll( bits ));
+#endif
+    }
+
+    // Sets or clears the inclusive local interval [first, last] of a bitmap
+    // chunk, updating its cardinality.
+    static void _fillBitmap( Chunk& chunk, unsigned int first,
+                             unsigned int last, bool value )
+    {
+      for( unsigned int w = first >> 6; w <= ( last >> 6 ); ++w )
+      {
+        unsigned int lo = std::max( first, w << 6 ) & 63;
+        unsigned int hi = std::min( last, ( w << 6 ) + 63 ) & 63;
+
+        uint64_t mask = ( ~uint64_t( 0 ) << lo ) &
+                        ( ~uint64_t( 0 ) >> ( 63 - hi ));
+
+        uint64_t& word = chunk.bitmap[ w ];
+        if( value )
+        {
+          chunk.cardinality += _popCount( ~word & mask );
+          word |= mask;
+        }
+        else
+        {
+          chunk.cardinality -= _popCount( word & mask );
+          word &= ~mask;
+        }
+      }
+    }
+
+    // Inserts the inclusive local interval [first, last], which may overlap
+    // existing elements.
+    void _insertLocal( Chunk& chunk, uint16_t first, uint16_t last )
+    {
+      unsigned int previous = chunk.cardinality;
+
+      if( chunk.isBitmap( ))
+      {
+        _fillBitmap( chunk, first, last, true );
+
+        if( chunk.cardinality == CHUNK_SIZE )
+        {
+          std::vector< uint64_t >( ).swap( chunk.bitmap );
+          chunk.runs.assign( 1, Run( 0, uint16_t( CHUNK_MASK )));
+        }
+      }
+      else
+      {
+        // Merge with every run overlapping or adjacent to [first, last].
+        auto it = _runAfter( chunk, first );
+        if( it != chunk.runs.begin( ) && unsigned(( it - 1 )->last ) + 1 >= first )
+          --it;
+
+        unsigned int newFirst = first;
+        unsigned int newLast = last;
+        auto end_ = it;
+        while( end_ != chunk.runs.end( ) && end_->start <= newLast + 1u )
+        {
+          newFirst = std::min< unsigned int >( newFirst, end_->start );
+          newLast = std::max< unsigned int >( newLast, end_->last );
+          chunk.cardinality -= unsigned( end_->last - end_->start ) + 1;
+          ++end_;
+        }
+
+        it = chunk.runs.erase( it, end_ );
+        chunk.runs.insert( it, Run( uint16_t( newFirst ), uint16_t( newLast )));
+        chunk.cardinality += newLast - newFirst + 1;
+
+        if( chunk.runs.size( ) > MAX_RUNS )
+          _toBitmap( chunk );
+      }
+
+      _size += chunk.cardinality - previous;
+    }
+
+    // Removes the inclusive local interval [first, last] of the chunk with
+    // the given key, dropping the chunk once empty.
+    void _removeFromChunk( unsigned int key, uint16_t first, uint16_t last )
+    {
+      Chunk* chunk = _findChunk( key );
+      if( !chunk )
+        return;
+
+      _removeLocal( *chunk, first, last );
+
+      if( chunk->cardinality == 0 )
+        _chunks.erase( _chunks.begin( ) + ( chunk - _chunks.data( )));
+    }
+
+    // Removes the inclusive local interval [first, last], which may contain
+    // elements not in the set.
+    void _removeLocal( Chunk& chunk, uint16_t first, uint16_t last )
+    {
+      unsigned int previous = chunk.cardinality;
+
+      if( chunk.isBitmap( ))
+      {
+        _fillBitmap( chunk, first, last, false );
+      }
+      else
+      {
+        auto it = _runAfter( chunk, first );
+        if( it != chunk.runs.begin( ) && ( it - 1 )->last >= first )
+          --it;
+
+        while( it != chunk.runs.end( ) && it->start <= last )
+        {
+          if( it->start < first && it->last > last )
+          {
+            Run tail( uint16_t( last + 1 ), it->last );
+            it->last = uint16_t( first - 1 );
+            chunk.cardinality -= unsigned( last - first ) + 1;
+            chunk.runs.insert( it + 1, tail );
+            break;
+          }
+
+          if( it->start < first )
+          {
+            chunk.cardinality -= unsigned( it->last - first ) + 1;
+            it->last = uint16_t( first - 1 );
+            ++it;
+          }
+          else if( it->last > last )
+          {
+            chunk.cardinality -= unsigned( last - it->start ) + 1;
+            it->start = uint16_t( last + 1 );
+            break;
+          }
+          else
+          {
+            chunk.cardinality -= unsigned( it->last - it->start ) + 1;
+            it = chunk.runs.erase( it );
+          }
+        }
+
+        // Splitting runs can fragment the chunk as much as inserting.
+        if( chunk.runs.size( ) > MAX_RUNS )
+          _toBitmap( chunk );
+      }
+
+      _size -= previous - chunk.cardinality;
+    }
+
+    static void _toBitmap( Chunk& chunk )
+    {
+      chunk.bitmap.assign( BITMAP_WORDS, 0 );
+      chunk.cardinality = 0;
+      for( auto const& run : chunk.runs )
+        _fillBitmap( chunk, run.start, run.last, true );
+
+      std::vector< Run >( ).swap( chunk.runs );
+    }
+
+    // Places the iterator on the first element of the given chunk, or at
+    // the end if there are no more chunks.
+    void _first( const_iterator& it, unsigned int chunkIdx ) const
+    {
+      it._chunk = chunkIdx;
+      it._run = 0;
+      it._value = 0;
+
+      if( chunkIdx >= _chunks.size( ))
+        return;
+
+      const Chunk& chunk = _chunks[ chunkIdx ];
+      it._value = chunk.base( ) + ( chunk.isBitmap( ) ?
+                                    _scan( chunk.bitmap, 0, true ) :
+                                    chunk.runs.front( ).start );
+    }
+
+    void _last( const_iterator& it, unsigned int chunkIdx ) const
+    {
+      const Chunk& chunk = _chunks[ chunkIdx ];
+
+      it._chunk = chunkIdx;
+      it._run = 0;
+
+      if( chunk.isBitmap( ))
+      {
+        it._value = chunk.base( ) + _scanBackward( chunk.bitmap, CHUNK_MASK );
+      }
+      else
+      {
+        it._run = unsigned( chunk.runs.size( )) - 1;
+        it._value = chunk.base( ) + chunk.runs.back( ).last;
+      }
+    }
+
+    void _next( const_iterator& it ) const
+    {
+      const Chunk& chunk = _chunks[ it._chunk ];
+      unsigned int low = it._value - chunk.base( );
+
+      if( chunk.isBitmap( ))
+      {
+        unsigned int pos = low + 1 < CHUNK_SIZE ?
+                           _scan( chunk.bitmap, low + 1, true ) : CHUNK_SIZE;
+        if( pos < CHUNK_SIZE )
+        {
+          it._value = chunk.base( ) + pos;
+          return;
+        }
+      }
+      else if( low < chunk.runs[ it._run ].last )
+      {
+        ++it._value;
+        return;
+      }
+      else if( it._run + 1 < chunk.runs.size( ))
+      {
+        ++it._run;
+        it._value = chunk.base( ) + chunk.runs[ it._run ].start;
+        return;
+      }
+
+      _first( it, it._chunk + 1 );
+    }
+
+    void _previous( const_iterator& it ) const
+    {
+      if( it._chunk >= _chunks.size( ))
+      {
+        _last( it, unsigned( _chunks.size( )) - 1 );
+        return;
+      }
+
+      const Chunk& chunk = _chunks[ it._chunk ];
+      unsigned int low = it._value - chunk.base( );
+
+      if( chunk.isBitmap( ))
+      {
+        unsigned int pos = low > 0 ?
+                           _scanBackward( chunk.bitmap, low - 1 ) : CHUNK_SIZE;
+        if( pos < CHUNK_SIZE )
+        {
+          it._value = chunk.base( ) + pos;
+          return;
+        }
+      }
+      else if( low > chunk.runs[ it._run ].start )
+      {
+        --it._value;
+        return;
+      }
+      else if( it._run > 0 )
+      {
+        --it._run;
+        it._value = chunk.base( ) + chunk.runs[ it._run ].last;
+        return;
+      }
+
+      _last( it, it._chunk - 1 );
+    }
+
+    std::vector< Chunk > _chunks;
+    size_t _size;
+  };
+
+}
+
+#endif /* __UTILS_RANGESET__ */
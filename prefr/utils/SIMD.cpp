@@ -0,0 +1,1414 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) || \
+    defined( __i386__ ) || defined( _M_IX86 )
+#define PREFR_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang require enabling the instruction set per function, so the
+// rest of the library keeps being built for the baseline architecture.
+#if defined( PREFR_SIMD_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ))
+#define PREFR_SIMD_TARGET( isa ) __attribute__(( target( isa )))
+#else
+#define PREFR_SIMD_TARGET( isa )
+#endif
+
+namespace prefr
+{
+  namespace simd
+  {
+
+    // Polynomial coefficients of sin( x ) and cos( x ) for x in
+    // [ -pi/4, pi/4 ].
+    static const float _halfPi = 1.57079632679f;
+    static const float _sin1 = -1.0f / 6.0f;
+    static const float _sin2 = 1.0f / 120.0f;
+    static const float _sin3 = -1.0f / 5040.0f;
+    static const float _sin4 = 1.0f / 362880.0f;
+    static const float _cos1 = -1.0f / 2.0f;
+    static const float _cos2 = 1.0f / 24.0f;
+    static const float _cos3 = -1.0f / 720.0f;
+    static const float _cos4 = 1.0f / 40320.0f;
+
+    // Scalar kernels, also used for the remainders of vectorized loops.
+
+    static void _decreaseLife( float* life, unsigned int size,
+                               float deltaTime )
+    {
+      for( unsigned int i = 0; i < size; ++i )
+        life[ i ] -= deltaTime;
+    }
+
+    static void _integrate( float* const* position,
+                            const float* const* velocity,
+                            const float* velocityModule, const char* alive,
+                            unsigned int begin, unsigned int end,
+                            float deltaTime )
+    {
+      for( unsigned int i = begin; i < end; ++i )
+      {
+        float module = alive[ i ] ? velocityModule[ i ] : 0.0f;
+
+        for( unsigned int c = 0; c < 3; ++c )
+          position[ c ][ i ] += velocity[ c ][ i ] * module * deltaTime;
+      }
+    }
+
+    static unsigned int _expire( float* life, char* alive,
+                                 unsigned int* killed, unsigned int begin,
+                                 unsigned int end )
+    {
+      unsigned int count = 0;
+      for( unsigned int i = begin; i < end; ++i )
+      {
+        if( alive[ i ] && life[ i ] <= 0.0f )
+        {
+          life[ i ] = 0.0f;
+          alive[ i ] = false;
+          killed[ count++ ] = i;
+        }
+      }
+
+      return count;
+    }
+
+    static void _coneDirections( const float* u, const float* v,
+                                 float* const* direction, unsigned int begin,
+                                 unsigned int end, float cosAngle )
+    {
+      float height = 1.0f - cosAngle;
+
+      for( unsigned int i = begin; i < end; ++i )
+      {
+        float y = 1.0f - u[ i ] * height;
+        float radius = std::sqrt( std::max( 1.0f - y * y, 0.0f ));
+
+        // Angle around the axis as a quadrant plus an offset in
+        // [ -pi/4, pi/4 ].
+        float turns = v[ i ] * 4.0f;
+        float quadrant = std::floor( turns + 0.5f );
+        float x = ( turns - quadrant ) * _halfPi;
+        float x2 = x * x;
+
+        float sine = (( _sin4 * x2 + _sin3 ) * x2 + _sin2 ) * x2 + _sin1;
+        sine = ( x * x2 ) * sine + x;
+        float cosine = (( _cos4 * x2 + _cos3 ) * x2 + _cos2 ) * x2 + _cos1;
+        cosine = x2 * cosine + 1.0f;
+
+        unsigned int q = unsigned( quadrant ) & 3;
+        if( q & 1 )
+          std::swap( sine, cosine );
+        if( q & 2 )
+          sine = -sine;
+        if(( q + 1 ) & 2 )
+          cosine = -cosine;
+
+        direction[ 0 ][ i ] = cosine * radius;
+        direction[ 1 ][ i ] = y;
+        direction[ 2 ][ i ] = sine * radius;
+      }
+    }
+
+    static void _cameraDistances( const float* const* position,
+                                  float* distances, unsigned int begin,
+                                  unsigned int end, const float* camera,
+                                  bool squared )
+    {
+      for( unsigned int i = begin; i < end; ++i )
+      {
+        float x = position[ 0 ][ i ] - camera[ 0 ];
+        float y = position[ 1 ][ i ] - camera[ 1 ];
+        float z = position[ 2 ][ i ] - camera[ 2 ];
+
+        float distance = x * x + y * y + z * z;
+        distances[ i ] = squared ? distance : std::sqrt( distance );
+      }
+    }
+
+    static void _cameraDepths( const float* const* position, float* depths,
+                               unsigned int begin, unsigned int end,
+                               const float* camera, const float* axis )
+    {
+      for( unsigned int i = begin; i < end; ++i )
+      {
+        depths[ i ] = ( position[ 0 ][ i ] - camera[ 0 ]) * axis[ 0 ] +
+                      ( position[ 1 ][ i ] - camera[ 1 ]) * axis[ 1 ] +
+                      ( position[ 2 ][ i ] - camera[ 2 ]) * axis[ 2 ];
+      }
+    }
+
+    // Converts a float to half float bits, rounding to nearest even. Values
+    // too large for half floats become infinities.
+    static inline uint16_t _half( float value )
+    {
+      uint32_t bits;
+      std::memcpy( &bits, &value, sizeof( bits ));
+
+      uint32_t sign = ( bits >> 16 ) & 0x8000u;
+      uint32_t magnitude = bits & 0x7FFFFFFFu;
+      uint32_t result;
+
+      if( magnitude > 0x7F800000u )
+        result = 0x7E00u;
+      else if( magnitude > 0x477FEFFFu )
+        result = 0x7C00u;
+      else if( magnitude < 0x38800000u )
+      {
+        // Adding 0.5 aligns the mantissa of half subnormals, rounding it.
+        float aligned;
+        std::memcpy( &aligned, &magnitude, sizeof( aligned ));
+        aligned += 0.5f;
+        std::memcpy( &result, &aligned, sizeof( result ));
+        result -= 0x3F000000u;
+      }
+      else
+      {
+        // Rebiases the exponent and rounds the 13 dropped mantissa bits.
+        uint32_t odd = ( magnitude >> 13 ) & 1;
+        result = ( magnitude + 0xC8000FFFu + odd ) >> 13;
+      }
+
+      return uint16_t( sign | result );
+    }
+
+    // Converts a value in [0, 1] to an 8-bit normalized integer. NaN values
+    // are stored as 0, as in the vectorized kernels.
+    static inline uint8_t _unorm8( float value )
+    {
+      value = value > 0.0f ? ( value < 1.0f ? value : 1.0f ) : 0.0f;
+      return uint8_t( value * 255.0f + 0.5f );
+    }
+
+    static void _packInstances( const float* const* values,
+                                unsigned char* instances, unsigned int begin,
+                                unsigned int end )
+    {
+      for( unsigned int i = begin; i < end; ++i )
+      {
+        unsigned char* instance = instances + i * packedInstanceSize;
+
+        uint16_t halves[ 4 ];
+        for( unsigned int c = 0; c < 4; ++c )
+        {
+          halves[ c ] = _half( values[ c ][ i ]);
+          instance[ 8 + c ] = _unorm8( values[ 4 + c ][ i ]);
+        }
+
+        std::memcpy( instance, halves, sizeof( halves ));
+      }
+    }
+
+    static void _halfFloats( const float* values, uint16_t* halves,
+                             unsigned int begin, unsigned int end )
+    {
+      for( unsigned int i = begin; i < end; ++i )
+        halves[ i ] = _half( values[ i ]);
+    }
+
+    // Kills the particles flagged in the given lane mask.
+    static unsigned int _expireLanes( float* life, char* alive,
+                                      unsigned int* killed, unsigned int first,
+                                      unsigned int mask )
+    {
+      unsigned int count = 0;
+      for( unsigned int lane = 0; mask != 0; ++lane, mask >>= 1 )
+      {
+        if( mask & 1 )
+        {
+          life[ first + lane ] = 0.0f;
+          alive[ first + lane ] = false;
+          killed[ count++ ] = first + lane;
+        }
+      }
+
+      return count;
+    }
+
+#ifdef PREFR_SIMD_X86
+
+    // SSE4.1 kernels, 4 particles per iteration.
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _decreaseLifeSSE4( float* life, unsigned int size,
+                                   float deltaTime )
+    {
+      const __m128 delta = _mm_set1_ps( deltaTime );
+
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+        _mm_storeu_ps( life + i, _mm_sub_ps( _mm_loadu_ps( life + i ), delta ));
+
+      _decreaseLife( life + i, size - i, deltaTime );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static __m128 _aliveMaskSSE4( const char* alive )
+    {
+      int flags;
+      std::memcpy( &flags, alive, sizeof( flags ));
+
+      __m128i values = _mm_cvtepi8_epi32( _mm_cvtsi32_si128( flags ));
+      return _mm_castsi128_ps(
+          _mm_cmpeq_epi32( values, _mm_setzero_si128( )));
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _integrateSSE4( float* const* position,
+                                const float* const* velocity,
+                                const float* velocityModule, const char* alive,
+                                unsigned int size, float deltaTime )
+    {
+      const __m128 delta = _mm_set1_ps( deltaTime );
+
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+      {
+        // Zero the module of dead particles.
+        __m128 module = _mm_andnot_ps( _aliveMaskSSE4( alive + i ),
+                                       _mm_loadu_ps( velocityModule + i ));
+
+        for( unsigned int c = 0; c < 3; ++c )
+        {
+          __m128 step = _mm_mul_ps(
+              _mm_mul_ps( _mm_loadu_ps( velocity[ c ] + i ), module ), delta );
+          _mm_storeu_ps( position[ c ] + i,
+                         _mm_add_ps( _mm_loadu_ps( position[ c ] + i ), step ));
+        }
+      }
+
+      _integrate( position, velocity, velocityModule, alive, i, size,
+                  deltaTime );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static unsigned int _expireSSE4( float* life, char* alive,
+                                     unsigned int* killed, unsigned int size )
+    {
+      const __m128 zero = _mm_setzero_ps( );
+
+      unsigned int count = 0;
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+      {
+        __m128 expired = _mm_andnot_ps( _aliveMaskSSE4( alive + i ),
+            _mm_cmple_ps( _mm_loadu_ps( life + i ), zero ));
+
+        unsigned int mask = _mm_movemask_ps( expired );
+        if( mask )
+          count += _expireLanes( life, alive, killed + count, i, mask );
+      }
+
+      return count + _expire( life, alive, killed + count, i, size );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _coneDirectionsSSE4( const float* u, const float* v,
+                                     float* const* direction,
+                                     unsigned int size, float cosAngle )
+    {
+      const __m128 one = _mm_set1_ps( 1.0f );
+      const __m128 height = _mm_set1_ps( 1.0f - cosAngle );
+      const __m128i oddQuadrant = _mm_set1_epi32( 1 );
+      const __m128i negativeQuadrant = _mm_set1_epi32( 2 );
+
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+      {
+        __m128 y = _mm_sub_ps( one, _mm_mul_ps( _mm_loadu_ps( u + i ),
+                                                height ));
+        __m128 radius = _mm_sqrt_ps( _mm_max_ps(
+            _mm_sub_ps( one, _mm_mul_ps( y, y )), _mm_setzero_ps( )));
+
+        __m128 turns = _mm_mul_ps( _mm_loadu_ps( v + i ), _mm_set1_ps( 4.0f ));
+        __m128 quadrant = _mm_floor_ps(
+            _mm_add_ps( turns, _mm_set1_ps( 0.5f )));
+        __m128 x = _mm_mul_ps( _mm_sub_ps( turns, quadrant ),
+                               _mm_set1_ps( _halfPi ));
+        __m128 x2 = _mm_mul_ps( x, x );
+
+        __m128 sine = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( _sin4 ), x2 ),
+                                  _mm_set1_ps( _sin3 ));
+        sine = _mm_add_ps( _mm_mul_ps( sine, x2 ), _mm_set1_ps( _sin2 ));
+        sine = _mm_add_ps( _mm_mul_ps( sine, x2 ), _mm_set1_ps( _sin1 ));
+        sine = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( x, x2 ), sine ), x );
+
+        __m128 cosine = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( _cos4 ), x2 ),
+                                    _mm_set1_ps( _cos3 ));
+        cosine = _mm_add_ps( _mm_mul_ps( cosine, x2 ), _mm_set1_ps( _cos2 ));
+        cosine = _mm_add_ps( _mm_mul_ps( cosine, x2 ), _mm_set1_ps( _cos1 ));
+        cosine = _mm_add_ps( _mm_mul_ps( x2, cosine ), one );
+
+        __m128i q = _mm_cvttps_epi32( quadrant );
+        __m128 swap = _mm_castsi128_ps( _mm_cmpeq_epi32(
+            _mm_and_si128( q, oddQuadrant ), oddQuadrant ));
+
+        __m128 s = _mm_blendv_ps( sine, cosine, swap );
+        __m128 c = _mm_blendv_ps( cosine, sine, swap );
+
+        s = _mm_xor_ps( s, _mm_castsi128_ps( _mm_slli_epi32(
+            _mm_and_si128( q, negativeQuadrant ), 30 )));
+        c = _mm_xor_ps( c, _mm_castsi128_ps( _mm_slli_epi32(
+            _mm_and_si128( _mm_add_epi32( q, oddQuadrant ),
+                           negativeQuadrant ), 30 )));
+
+        _mm_storeu_ps( direction[ 0 ] + i, _mm_mul_ps( c, radius ));
+        _mm_storeu_ps( direction[ 1 ] + i, y );
+        _mm_storeu_ps( direction[ 2 ] + i, _mm_mul_ps( s, radius ));
+      }
+
+      _coneDirections( u, v, direction, i, size, cosAngle );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _cameraDistancesSSE4( const float* const* position,
+                                      float* distances, unsigned int size,
+                                      const float* camera, bool squared )
+    {
+      const __m128 cx = _mm_set1_ps( camera[ 0 ]);
+      const __m128 cy = _mm_set1_ps( camera[ 1 ]);
+      const __m128 cz = _mm_set1_ps( camera[ 2 ]);
+
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+      {
+        __m128 x = _mm_sub_ps( _mm_loadu_ps( position[ 0 ] + i ), cx );
+        __m128 y = _mm_sub_ps( _mm_loadu_ps( position[ 1 ] + i ), cy );
+        __m128 z = _mm_sub_ps( _mm_loadu_ps( position[ 2 ] + i ), cz );
+
+        __m128 distance = _mm_mul_ps( x, x );
+        distance = _mm_add_ps( distance, _mm_mul_ps( y, y ));
+        distance = _mm_add_ps( distance, _mm_mul_ps( z, z ));
+
+        if( !squared )
+          distance = _mm_sqrt_ps( distance );
+
+        _mm_storeu_ps( distances + i, distance );
+      }
+
+      _cameraDistances( position, distances, i, size, camera, squared );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _cameraDepthsSSE4( const float* const* position,
+                                   float* depths, unsigned int size,
+                                   const float* camera, const float* axis )
+    {
+      const __m128 ax = _mm_set1_ps( axis[ 0 ]);
+      const __m128 ay = _mm_set1_ps( axis[ 1 ]);
+      const __m128 az = _mm_set1_ps( axis[ 2 ]);
+      const __m128 offset = _mm_set1_ps(
+          camera[ 0 ] * axis[ 0 ] + camera[ 1 ] * axis[ 1 ] +
+          camera[ 2 ] * axis[ 2 ]);
+
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+      {
+        __m128 depth = _mm_mul_ps( _mm_loadu_ps( position[ 0 ] + i ), ax );
+        depth = _mm_add_ps(
+            depth, _mm_mul_ps( _mm_loadu_ps( position[ 1 ] + i ), ay ));
+        depth = _mm_add_ps(
+            depth, _mm_mul_ps( _mm_loadu_ps( position[ 2 ] + i ), az ));
+
+        _mm_storeu_ps( depths + i, _mm_sub_ps( depth, offset ));
+      }
+
+      _cameraDepths( position, depths, i, size, camera, axis );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static __m128i _halfSSE4( __m128 value )
+    {
+      __m128i bits = _mm_castps_si128( value );
+      __m128i sign = _mm_and_si128(
+          bits, _mm_set1_epi32( int( 0x80000000u )));
+      __m128i magnitude = _mm_xor_si128( bits, sign );
+
+      __m128i subnormal = _mm_sub_epi32(
+          _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps( magnitude ),
+                                        _mm_set1_ps( 0.5f ))),
+          _mm_set1_epi32( 0x3F000000 ));
+
+      __m128i odd = _mm_and_si128( _mm_srli_epi32( magnitude, 13 ),
+                                   _mm_set1_epi32( 1 ));
+      __m128i normal = _mm_add_epi32(
+          magnitude, _mm_set1_epi32( int( 0xC8000FFFu )));
+      normal = _mm_srli_epi32( _mm_add_epi32( normal, odd ), 13 );
+
+      __m128i result = _mm_blendv_epi8( normal, subnormal,
+          _mm_cmplt_epi32( magnitude, _mm_set1_epi32( 0x38800000 )));
+      result = _mm_blendv_epi8( result, _mm_set1_epi32( 0x7C00 ),
+          _mm_cmpgt_epi32( magnitude, _mm_set1_epi32( 0x477FEFFF )));
+      result = _mm_blendv_epi8( result, _mm_set1_epi32( 0x7E00 ),
+          _mm_cmpgt_epi32( magnitude, _mm_set1_epi32( 0x7F800000 )));
+
+      return _mm_or_si128( result, _mm_srli_epi32( sign, 16 ));
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static __m128i _unorm8SSE4( __m128 value )
+    {
+      value = _mm_min_ps( _mm_max_ps( value, _mm_setzero_ps( )),
+                          _mm_set1_ps( 1.0f ));
+
+      return _mm_cvttps_epi32( _mm_add_ps(
+          _mm_mul_ps( value, _mm_set1_ps( 255.0f )), _mm_set1_ps( 0.5f )));
+    }
+
+    // Stores 4 packed instances from their half float position and size
+    // components and their RGBA8 colors, one instance per 32-bit lane.
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _storeInstancesSSE4( unsigned char* instances, __m128i x,
+                                     __m128i y, __m128i z, __m128i size,
+                                     __m128i rgba )
+    {
+      __m128i xy = _mm_or_si128( x, _mm_slli_epi32( y, 16 ));
+      __m128i zs = _mm_or_si128( z, _mm_slli_epi32( size, 16 ));
+
+      // Halves of instances 0 and 1, and of instances 2 and 3.
+      __m128 first = _mm_castsi128_ps( _mm_unpacklo_epi32( xy, zs ));
+      __m128 second = _mm_castsi128_ps( _mm_unpackhi_epi32( xy, zs ));
+
+      // Colors interleaved with the words of instances 1 and 3.
+      __m128 odd = _mm_castsi128_ps( _mm_unpacklo_epi32(
+          rgba, _mm_castps_si128( _mm_movehl_ps( first, first ))));
+      __m128 last = _mm_castsi128_ps(
+          _mm_unpackhi_epi32( rgba, _mm_castps_si128( second )));
+
+      float* output = reinterpret_cast< float* >( instances );
+      _mm_storeu_ps( output, _mm_shuffle_ps( first, odd,
+                                             _MM_SHUFFLE( 1, 0, 1, 0 )));
+      _mm_storeu_ps( output + 4, _mm_shuffle_ps( odd, second,
+                                                 _MM_SHUFFLE( 1, 0, 2, 3 )));
+      _mm_storeu_ps( output + 8, _mm_shuffle_ps( last, last,
+                                                 _MM_SHUFFLE( 2, 3, 1, 0 )));
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _packInstancesSSE4( const float* const* values,
+                                    unsigned char* instances,
+                                    unsigned int size )
+    {
+      unsigned int i = 0;
+      for( ; i + 4 <= size; i += 4 )
+      {
+        __m128i rgba = _unorm8SSE4( _mm_loadu_ps( values[ 4 ] + i ));
+        rgba = _mm_or_si128( rgba, _mm_slli_epi32(
+            _unorm8SSE4( _mm_loadu_ps( values[ 5 ] + i )), 8 ));
+        rgba = _mm_or_si128( rgba, _mm_slli_epi32(
+            _unorm8SSE4( _mm_loadu_ps( values[ 6 ] + i )), 16 ));
+        rgba = _mm_or_si128( rgba, _mm_slli_epi32(
+            _unorm8SSE4( _mm_loadu_ps( values[ 7 ] + i )), 24 ));
+
+        _storeInstancesSSE4( instances + i * packedInstanceSize,
+                             _halfSSE4( _mm_loadu_ps( values[ 0 ] + i )),
+                             _halfSSE4( _mm_loadu_ps( values[ 1 ] + i )),
+                             _halfSSE4( _mm_loadu_ps( values[ 2 ] + i )),
+                             _halfSSE4( _mm_loadu_ps( values[ 3 ] + i )),
+                             rgba );
+      }
+
+      _packInstances( values, instances, i, size );
+    }
+
+    PREFR_SIMD_TARGET( "sse4.1" )
+    static void _halfFloatsSSE4( const float* values, uint16_t* halves,
+                                 unsigned int size )
+    {
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m128i first = _halfSSE4( _mm_loadu_ps( values + i ));
+        __m128i second = _halfSSE4( _mm_loadu_ps( values + i + 4 ));
+
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( halves + i ),
+                          _mm_packus_epi32( first, second ));
+      }
+
+      _halfFloats( values, halves, i, size );
+    }
+
+    // AVX2 kernels, 8 particles per iteration.
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _decreaseLifeAVX2( float* life, unsigned int size,
+                                   float deltaTime )
+    {
+      const __m256 delta = _mm256_set1_ps( deltaTime );
+
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+        _mm256_storeu_ps( life + i,
+                          _mm256_sub_ps( _mm256_loadu_ps( life + i ), delta ));
+
+      _decreaseLife( life + i, size - i, deltaTime );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static __m256 _aliveMaskAVX2( const char* alive )
+    {
+      __m128i flags =
+          _mm_loadl_epi64( reinterpret_cast< const __m128i* >( alive ));
+
+      __m256i values = _mm256_cvtepi8_epi32( flags );
+      return _mm256_castsi256_ps(
+          _mm256_cmpeq_epi32( values, _mm256_setzero_si256( )));
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _integrateAVX2( float* const* position,
+                                const float* const* velocity,
+                                const float* velocityModule, const char* alive,
+                                unsigned int size, float deltaTime )
+    {
+      const __m256 delta = _mm256_set1_ps( deltaTime );
+
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256 module = _mm256_andnot_ps( _aliveMaskAVX2( alive + i ),
+                                          _mm256_loadu_ps( velocityModule + i ));
+
+        for( unsigned int c = 0; c < 3; ++c )
+        {
+          __m256 step = _mm256_mul_ps(
+              _mm256_mul_ps( _mm256_loadu_ps( velocity[ c ] + i ), module ),
+              delta );
+          _mm256_storeu_ps( position[ c ] + i,
+                            _mm256_add_ps( _mm256_loadu_ps( position[ c ] + i ),
+                                           step ));
+        }
+      }
+
+      _integrate( position, velocity, velocityModule, alive, i, size,
+                  deltaTime );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static unsigned int _expireAVX2( float* life, char* alive,
+                                     unsigned int* killed, unsigned int size )
+    {
+      const __m256 zero = _mm256_setzero_ps( );
+
+      unsigned int count = 0;
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256 expired = _mm256_andnot_ps( _aliveMaskAVX2( alive + i ),
+            _mm256_cmp_ps( _mm256_loadu_ps( life + i ), zero, _CMP_LE_OQ ));
+
+        unsigned int mask = _mm256_movemask_ps( expired );
+        if( mask )
+          count += _expireLanes( life, alive, killed + count, i, mask );
+      }
+
+      return count + _expire( life, alive, killed + count, i, size );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _coneDirectionsAVX2( const float* u, const float* v,
+                                     float* const* direction,
+                                     unsigned int size, float cosAngle )
+    {
+      const __m256 one = _mm256_set1_ps( 1.0f );
+      const __m256 height = _mm256_set1_ps( 1.0f - cosAngle );
+      const __m256i oddQuadrant = _mm256_set1_epi32( 1 );
+      const __m256i negativeQuadrant = _mm256_set1_epi32( 2 );
+
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256 y = _mm256_sub_ps( one, _mm256_mul_ps( _mm256_loadu_ps( u + i ),
+                                                      height ));
+        __m256 radius = _mm256_sqrt_ps( _mm256_max_ps(
+            _mm256_sub_ps( one, _mm256_mul_ps( y, y )),
+            _mm256_setzero_ps( )));
+
+        __m256 turns = _mm256_mul_ps( _mm256_loadu_ps( v + i ),
+                                      _mm256_set1_ps( 4.0f ));
+        __m256 quadrant = _mm256_floor_ps(
+            _mm256_add_ps( turns, _mm256_set1_ps( 0.5f )));
+        __m256 x = _mm256_mul_ps( _mm256_sub_ps( turns, quadrant ),
+                                  _mm256_set1_ps( _halfPi ));
+        __m256 x2 = _mm256_mul_ps( x, x );
+
+        __m256 sine = _mm256_add_ps(
+            _mm256_mul_ps( _mm256_set1_ps( _sin4 ), x2 ),
+            _mm256_set1_ps( _sin3 ));
+        sine = _mm256_add_ps( _mm256_mul_ps( sine, x2 ),
+                              _mm256_set1_ps( _sin2 ));
+        sine = _mm256_add_ps( _mm256_mul_ps( sine, x2 ),
+                              _mm256_set1_ps( _sin1 ));
+        sine = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( x, x2 ), sine ),
+                              x );
+
+        __m256 cosine = _mm256_add_ps(
+            _mm256_mul_ps( _mm256_set1_ps( _cos4 ), x2 ),
+            _mm256_set1_ps( _cos3 ));
+        cosine = _mm256_add_ps( _mm256_mul_ps( cosine, x2 ),
+                                _mm256_set1_ps( _cos2 ));
+        cosine = _mm256_add_ps( _mm256_mul_ps( cosine, x2 ),
+                                _mm256_set1_ps( _cos1 ));
+        cosine = _mm256_add_ps( _mm256_mul_ps( x2, cosine ), one );
+
+        __m256i q = _mm256_cvttps_epi32( quadrant );
+        __m256 swap = _mm256_castsi256_ps( _mm256_cmpeq_epi32(
+            _mm256_and_si256( q, oddQuadrant ), oddQuadrant ));
+
+        __m256 s = _mm256_blendv_ps( sine, cosine, swap );
+        __m256 c = _mm256_blendv_ps( cosine, sine, swap );
+
+        s = _mm256_xor_ps( s, _mm256_castsi256_ps( _mm256_slli_epi32(
+            _mm256_and_si256( q, negativeQuadrant ), 30 )));
+        c = _mm256_xor_ps( c, _mm256_castsi256_ps( _mm256_slli_epi32(
+            _mm256_and_si256( _mm256_add_epi32( q, oddQuadrant ),
+                              negativeQuadrant ), 30 )));
+
+        _mm256_storeu_ps( direction[ 0 ] + i, _mm256_mul_ps( c, radius ));
+        _mm256_storeu_ps( direction[ 1 ] + i, y );
+        _mm256_storeu_ps( direction[ 2 ] + i, _mm256_mul_ps( s, radius ));
+      }
+
+      _coneDirections( u, v, direction, i, size, cosAngle );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _cameraDistancesAVX2( const float* const* position,
+                                      float* distances, unsigned int size,
+                                      const float* camera, bool squared )
+    {
+      const __m256 cx = _mm256_set1_ps( camera[ 0 ]);
+      const __m256 cy = _mm256_set1_ps( camera[ 1 ]);
+      const __m256 cz = _mm256_set1_ps( camera[ 2 ]);
+
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256 x = _mm256_sub_ps( _mm256_loadu_ps( position[ 0 ] + i ), cx );
+        __m256 y = _mm256_sub_ps( _mm256_loadu_ps( position[ 1 ] + i ), cy );
+        __m256 z = _mm256_sub_ps( _mm256_loadu_ps( position[ 2 ] + i ), cz );
+
+        __m256 distance = _mm256_mul_ps( x, x );
+        distance = _mm256_add_ps( distance, _mm256_mul_ps( y, y ));
+        distance = _mm256_add_ps( distance, _mm256_mul_ps( z, z ));
+
+        if( !squared )
+          distance = _mm256_sqrt_ps( distance );
+
+        _mm256_storeu_ps( distances + i, distance );
+      }
+
+      _cameraDistances( position, distances, i, size, camera, squared );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _cameraDepthsAVX2( const float* const* position,
+                                   float* depths, unsigned int size,
+                                   const float* camera, const float* axis )
+    {
+      const __m256 ax = _mm256_set1_ps( axis[ 0 ]);
+      const __m256 ay = _mm256_set1_ps( axis[ 1 ]);
+      const __m256 az = _mm256_set1_ps( axis[ 2 ]);
+      const __m256 offset = _mm256_set1_ps(
+          camera[ 0 ] * axis[ 0 ] + camera[ 1 ] * axis[ 1 ] +
+          camera[ 2 ] * axis[ 2 ]);
+
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256 depth =
+            _mm256_mul_ps( _mm256_loadu_ps( position[ 0 ] + i ), ax );
+        depth = _mm256_add_ps(
+            depth, _mm256_mul_ps( _mm256_loadu_ps( position[ 1 ] + i ), ay ));
+        depth = _mm256_add_ps(
+            depth, _mm256_mul_ps( _mm256_loadu_ps( position[ 2 ] + i ), az ));
+
+        _mm256_storeu_ps( depths + i, _mm256_sub_ps( depth, offset ));
+      }
+
+      _cameraDepths( position, depths, i, size, camera, axis );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static __m256i _halfAVX2( __m256 value )
+    {
+      __m256i bits = _mm256_castps_si256( value );
+      __m256i sign = _mm256_and_si256(
+          bits, _mm256_set1_epi32( int( 0x80000000u )));
+      __m256i magnitude = _mm256_xor_si256( bits, sign );
+
+      __m256i subnormal = _mm256_sub_epi32(
+          _mm256_castps_si256( _mm256_add_ps(
+              _mm256_castsi256_ps( magnitude ), _mm256_set1_ps( 0.5f ))),
+          _mm256_set1_epi32( 0x3F000000 ));
+
+      __m256i odd = _mm256_and_si256( _mm256_srli_epi32( magnitude, 13 ),
+                                      _mm256_set1_epi32( 1 ));
+      __m256i normal = _mm256_add_epi32(
+          magnitude, _mm256_set1_epi32( int( 0xC8000FFFu )));
+      normal = _mm256_srli_epi32( _mm256_add_epi32( normal, odd ), 13 );
+
+      __m256i result = _mm256_blendv_epi8( normal, subnormal,
+          _mm256_cmpgt_epi32( _mm256_set1_epi32( 0x38800000 ), magnitude ));
+      result = _mm256_blendv_epi8( result, _mm256_set1_epi32( 0x7C00 ),
+          _mm256_cmpgt_epi32( magnitude, _mm256_set1_epi32( 0x477FEFFF )));
+      result = _mm256_blendv_epi8( result, _mm256_set1_epi32( 0x7E00 ),
+          _mm256_cmpgt_epi32( magnitude, _mm256_set1_epi32( 0x7F800000 )));
+
+      return _mm256_or_si256( result, _mm256_srli_epi32( sign, 16 ));
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static __m256i _unorm8AVX2( __m256 value )
+    {
+      value = _mm256_min_ps( _mm256_max_ps( value, _mm256_setzero_ps( )),
+                             _mm256_set1_ps( 1.0f ));
+
+      return _mm256_cvttps_epi32( _mm256_add_ps(
+          _mm256_mul_ps( value, _mm256_set1_ps( 255.0f )),
+          _mm256_set1_ps( 0.5f )));
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _packInstancesAVX2( const float* const* values,
+                                    unsigned char* instances,
+                                    unsigned int size )
+    {
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256i halves[ 4 ];
+        for( unsigned int c = 0; c < 4; ++c )
+          halves[ c ] = _halfAVX2( _mm256_loadu_ps( values[ c ] + i ));
+
+        __m256i rgba = _unorm8AVX2( _mm256_loadu_ps( values[ 4 ] + i ));
+        rgba = _mm256_or_si256( rgba, _mm256_slli_epi32(
+            _unorm8AVX2( _mm256_loadu_ps( values[ 5 ] + i )), 8 ));
+        rgba = _mm256_or_si256( rgba, _mm256_slli_epi32(
+            _unorm8AVX2( _mm256_loadu_ps( values[ 6 ] + i )), 16 ));
+        rgba = _mm256_or_si256( rgba, _mm256_slli_epi32(
+            _unorm8AVX2( _mm256_loadu_ps( values[ 7 ] + i )), 24 ));
+
+        unsigned char* output = instances + i * packedInstanceSize;
+
+        _storeInstancesSSE4( output,
+                             _mm256_castsi256_si128( halves[ 0 ]),
+                             _mm256_castsi256_si128( halves[ 1 ]),
+                             _mm256_castsi256_si128( halves[ 2 ]),
+                             _mm256_castsi256_si128( halves[ 3 ]),
+                             _mm256_castsi256_si128( rgba ));
+
+        _storeInstancesSSE4( output + 4 * packedInstanceSize,
+                             _mm256_extracti128_si256( halves[ 0 ], 1 ),
+                             _mm256_extracti128_si256( halves[ 1 ], 1 ),
+                             _mm256_extracti128_si256( halves[ 2 ], 1 ),
+                             _mm256_extracti128_si256( halves[ 3 ], 1 ),
+                             _mm256_extracti128_si256( rgba, 1 ));
+      }
+
+      _packInstances( values, instances, i, size );
+    }
+
+    PREFR_SIMD_TARGET( "avx2" )
+    static void _halfFloatsAVX2( const float* values, uint16_t* halves,
+                                 unsigned int size )
+    {
+      unsigned int i = 0;
+      for( ; i + 8 <= size; i += 8 )
+      {
+        __m256i result = _halfAVX2( _mm256_loadu_ps( values + i ));
+
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( halves + i ),
+                          _mm_packus_epi32(
+                              _mm256_castsi256_si128( result ),
+                              _mm256_extracti128_si256( result, 1 )));
+      }
+
+      _halfFloats( values, halves, i, size );
+    }
+
+    // AVX-512 kernels, 16 particles per iteration.
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _decreaseLifeAVX512( float* life, unsigned int size,
+                                     float deltaTime )
+    {
+      const __m512 delta = _mm512_set1_ps( deltaTime );
+
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+        _mm512_storeu_ps( life + i,
+                          _mm512_sub_ps( _mm512_loadu_ps( life + i ), delta ));
+
+      _decreaseLife( life + i, size - i, deltaTime );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static __mmask16 _aliveMaskAVX512( const char* alive )
+    {
+      __m512i values = _mm512_cvtepi8_epi32(
+          _mm_loadu_si128( reinterpret_cast< const __m128i* >( alive )));
+
+      return _mm512_test_epi32_mask( values, values );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _integrateAVX512( float* const* position,
+                                  const float* const* velocity,
+                                  const float* velocityModule,
+                                  const char* alive, unsigned int size,
+                                  float deltaTime )
+    {
+      const __m512 delta = _mm512_set1_ps( deltaTime );
+
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+      {
+        __m512 module = _mm512_maskz_loadu_ps( _aliveMaskAVX512( alive + i ),
+                                               velocityModule + i );
+
+        for( unsigned int c = 0; c < 3; ++c )
+        {
+          __m512 step = _mm512_mul_ps(
+              _mm512_mul_ps( _mm512_loadu_ps( velocity[ c ] + i ), module ),
+              delta );
+          _mm512_storeu_ps( position[ c ] + i,
+                            _mm512_add_ps( _mm512_loadu_ps( position[ c ] + i ),
+                                           step ));
+        }
+      }
+
+      _integrate( position, velocity, velocityModule, alive, i, size,
+                  deltaTime );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static unsigned int _expireAVX512( float* life, char* alive,
+                                       unsigned int* killed, unsigned int size )
+    {
+      const __m512 zero = _mm512_setzero_ps( );
+
+      unsigned int count = 0;
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+      {
+        unsigned int mask = _mm512_mask_cmp_ps_mask(
+            _aliveMaskAVX512( alive + i ), _mm512_loadu_ps( life + i ),
+            zero, _CMP_LE_OQ );
+
+        if( mask )
+          count += _expireLanes( life, alive, killed + count, i, mask );
+      }
+
+      return count + _expire( life, alive, killed + count, i, size );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _coneDirectionsAVX512( const float* u, const float* v,
+                                       float* const* direction,
+                                       unsigned int size, float cosAngle )
+    {
+      const __m512 one = _mm512_set1_ps( 1.0f );
+      const __m512 height = _mm512_set1_ps( 1.0f - cosAngle );
+      const __m512i oddQuadrant = _mm512_set1_epi32( 1 );
+      const __m512i negativeQuadrant = _mm512_set1_epi32( 2 );
+
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+      {
+        __m512 y = _mm512_sub_ps( one, _mm512_mul_ps( _mm512_loadu_ps( u + i ),
+                                                      height ));
+        __m512 radius = _mm512_sqrt_ps( _mm512_max_ps(
+            _mm512_sub_ps( one, _mm512_mul_ps( y, y )),
+            _mm512_setzero_ps( )));
+
+        __m512 turns = _mm512_mul_ps( _mm512_loadu_ps( v + i ),
+                                      _mm512_set1_ps( 4.0f ));
+        __m512 quadrant = _mm512_roundscale_ps(
+            _mm512_add_ps( turns, _mm512_set1_ps( 0.5f )),
+            _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC );
+        __m512 x = _mm512_mul_ps( _mm512_sub_ps( turns, quadrant ),
+                                  _mm512_set1_ps( _halfPi ));
+        __m512 x2 = _mm512_mul_ps( x, x );
+
+        __m512 sine = _mm512_add_ps(
+            _mm512_mul_ps( _mm512_set1_ps( _sin4 ), x2 ),
+            _mm512_set1_ps( _sin3 ));
+        sine = _mm512_add_ps( _mm512_mul_ps( sine, x2 ),
+                              _mm512_set1_ps( _sin2 ));
+        sine = _mm512_add_ps( _mm512_mul_ps( sine, x2 ),
+                              _mm512_set1_ps( _sin1 ));
+        sine = _mm512_add_ps( _mm512_mul_ps( _mm512_mul_ps( x, x2 ), sine ),
+                              x );
+
+        __m512 cosine = _mm512_add_ps(
+            _mm512_mul_ps( _mm512_set1_ps( _cos4 ), x2 ),
+            _mm512_set1_ps( _cos3 ));
+        cosine = _mm512_add_ps( _mm512_mul_ps( cosine, x2 ),
+                                _mm512_set1_ps( _cos2 ));
+        cosine = _mm512_add_ps( _mm512_mul_ps( cosine, x2 ),
+                                _mm512_set1_ps( _cos1 ));
+        cosine = _mm512_add_ps( _mm512_mul_ps( x2, cosine ), one );
+
+        __m512i q = _mm512_cvttps_epi32( quadrant );
+        __mmask16 swap = _mm512_test_epi32_mask( q, oddQuadrant );
+
+        __m512 s = _mm512_mask_blend_ps( swap, sine, cosine );
+        __m512 c = _mm512_mask_blend_ps( swap, cosine, sine );
+
+        // Sign flips through integer operations, as AVX-512F lacks
+        // floating point xor.
+        s = _mm512_castsi512_ps( _mm512_xor_si512( _mm512_castps_si512( s ),
+            _mm512_slli_epi32( _mm512_and_si512( q, negativeQuadrant ), 30 )));
+        c = _mm512_castsi512_ps( _mm512_xor_si512( _mm512_castps_si512( c ),
+            _mm512_slli_epi32( _mm512_and_si512(
+                _mm512_add_epi32( q, oddQuadrant ), negativeQuadrant ), 30 )));
+
+        _mm512_storeu_ps( direction[ 0 ] + i, _mm512_mul_ps( c, radius ));
+        _mm512_storeu_ps( direction[ 1 ] + i, y );
+        _mm512_storeu_ps( direction[ 2 ] + i, _mm512_mul_ps( s, radius ));
+      }
+
+      _coneDirections( u, v, direction, i, size, cosAngle );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _cameraDistancesAVX512( const float* const* position,
+                                        float* distances, unsigned int size,
+                                        const float* camera, bool squared )
+    {
+      const __m512 cx = _mm512_set1_ps( camera[ 0 ]);
+      const __m512 cy = _mm512_set1_ps( camera[ 1 ]);
+      const __m512 cz = _mm512_set1_ps( camera[ 2 ]);
+
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+      {
+        __m512 x = _mm512_sub_ps( _mm512_loadu_ps( position[ 0 ] + i ), cx );
+        __m512 y = _mm512_sub_ps( _mm512_loadu_ps( position[ 1 ] + i ), cy );
+        __m512 z = _mm512_sub_ps( _mm512_loadu_ps( position[ 2 ] + i ), cz );
+
+        __m512 distance = _mm512_mul_ps( x, x );
+        distance = _mm512_add_ps( distance, _mm512_mul_ps( y, y ));
+        distance = _mm512_add_ps( distance, _mm512_mul_ps( z, z ));
+
+        if( !squared )
+          distance = _mm512_sqrt_ps( distance );
+
+        _mm512_storeu_ps( distances + i, distance );
+      }
+
+      _cameraDistances( position, distances, i, size, camera, squared );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _cameraDepthsAVX512( const float* const* position,
+                                     float* depths, unsigned int size,
+                                     const float* camera, const float* axis )
+    {
+      const __m512 ax = _mm512_set1_ps( axis[ 0 ]);
+      const __m512 ay = _mm512_set1_ps( axis[ 1 ]);
+      const __m512 az = _mm512_set1_ps( axis[ 2 ]);
+      const __m512 offset = _mm512_set1_ps(
+          camera[ 0 ] * axis[ 0 ] + camera[ 1 ] * axis[ 1 ] +
+          camera[ 2 ] * axis[ 2 ]);
+
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+      {
+        __m512 depth =
+            _mm512_mul_ps( _mm512_loadu_ps( position[ 0 ] + i ), ax );
+        depth = _mm512_add_ps(
+            depth, _mm512_mul_ps( _mm512_loadu_ps( position[ 1 ] + i ), ay ));
+        depth = _mm512_add_ps(
+            depth, _mm512_mul_ps( _mm512_loadu_ps( position[ 2 ] + i ), az ));
+
+        _mm512_storeu_ps( depths + i, _mm512_sub_ps( depth, offset ));
+      }
+
+      _cameraDepths( position, depths, i, size, camera, axis );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static __m512i _halfAVX512( __m512 value )
+    {
+      return _mm512_cvtepu16_epi32( _mm512_cvtps_ph(
+          value, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ));
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static __m512i _unorm8AVX512( __m512 value )
+    {
+      value = _mm512_min_ps( _mm512_max_ps( value, _mm512_setzero_ps( )),
+                             _mm512_set1_ps( 1.0f ));
+
+      return _mm512_cvttps_epi32( _mm512_add_ps(
+          _mm512_mul_ps( value, _mm512_set1_ps( 255.0f )),
+          _mm512_set1_ps( 0.5f )));
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _packInstancesAVX512( const float* const* values,
+                                      unsigned char* instances,
+                                      unsigned int size )
+    {
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+      {
+        __m512i halves[ 4 ];
+        for( unsigned int c = 0; c < 4; ++c )
+          halves[ c ] = _halfAVX512( _mm512_loadu_ps( values[ c ] + i ));
+
+        __m512i rgba = _unorm8AVX512( _mm512_loadu_ps( values[ 4 ] + i ));
+        rgba = _mm512_or_si512( rgba, _mm512_slli_epi32(
+            _unorm8AVX512( _mm512_loadu_ps( values[ 5 ] + i )), 8 ));
+        rgba = _mm512_or_si512( rgba, _mm512_slli_epi32(
+            _unorm8AVX512( _mm512_loadu_ps( values[ 6 ] + i )), 16 ));
+        rgba = _mm512_or_si512( rgba, _mm512_slli_epi32(
+            _unorm8AVX512( _mm512_loadu_ps( values[ 7 ] + i )), 24 ));
+
+        unsigned char* output = instances + i * packedInstanceSize;
+
+        _storeInstancesSSE4( output,
+                             _mm512_extracti32x4_epi32( halves[ 0 ], 0 ),
+                             _mm512_extracti32x4_epi32( halves[ 1 ], 0 ),
+                             _mm512_extracti32x4_epi32( halves[ 2 ], 0 ),
+                             _mm512_extracti32x4_epi32( halves[ 3 ], 0 ),
+                             _mm512_extracti32x4_epi32( rgba, 0 ));
+        _storeInstancesSSE4( output + 4 * packedInstanceSize,
+                             _mm512_extracti32x4_epi32( halves[ 0 ], 1 ),
+                             _mm512_extracti32x4_epi32( halves[ 1 ], 1 ),
+                             _mm512_extracti32x4_epi32( halves[ 2 ], 1 ),
+                             _mm512_extracti32x4_epi32( halves[ 3 ], 1 ),
+                             _mm512_extracti32x4_epi32( rgba, 1 ));
+        _storeInstancesSSE4( output + 8 * packedInstanceSize,
+                             _mm512_extracti32x4_epi32( halves[ 0 ], 2 ),
+                             _mm512_extracti32x4_epi32( halves[ 1 ], 2 ),
+                             _mm512_extracti32x4_epi32( halves[ 2 ], 2 ),
+                             _mm512_extracti32x4_epi32( halves[ 3 ], 2 ),
+                             _mm512_extracti32x4_epi32( rgba, 2 ));
+        _storeInstancesSSE4( output + 12 * packedInstanceSize,
+                             _mm512_extracti32x4_epi32( halves[ 0 ], 3 ),
+                             _mm512_extracti32x4_epi32( halves[ 1 ], 3 ),
+                             _mm512_extracti32x4_epi32( halves[ 2 ], 3 ),
+                             _mm512_extracti32x4_epi32( halves[ 3 ], 3 ),
+                             _mm512_extracti32x4_epi32( rgba, 3 ));
+      }
+
+      _packInstances( values, instances, i, size );
+    }
+
+    PREFR_SIMD_TARGET( "avx512f" )
+    static void _halfFloatsAVX512( const float* values, uint16_t* halves,
+                                   unsigned int size )
+    {
+      unsigned int i = 0;
+      for( ; i + 16 <= size; i += 16 )
+        _mm256_storeu_si256( reinterpret_cast< __m256i* >( halves + i ),
+                             _mm512_cvtps_ph( _mm512_loadu_ps( values + i ),
+                                              _MM_FROUND_TO_NEAREST_INT |
+                                              _MM_FROUND_NO_EXC ));
+
+      _halfFloats( values, halves, i, size );
+    }
+
+    static bool _supported( InstructionSet instructionSet_ )
+    {
+#if defined( __GNUC__ ) || defined( __clang__ )
+      __builtin_cpu_init( );
+
+      switch( instructionSet_ )
+      {
+        case SSE4:
+          return __builtin_cpu_supports( "sse4.1" );
+        case AVX2:
+          return __builtin_cpu_supports( "avx2" );
+        case AVX512:
+          return __builtin_cpu_supports( "avx512f" );
+        default:
+          return true;
+      }
+#elif defined( _MSC_VER )
+      int info[ 4 ];
+      __cpuid( info, 1 );
+
+      bool sse4 = ( info[ 2 ] & ( 1 << 19 )) != 0;
+      bool osxsave = ( info[ 2 ] & ( 1 << 27 )) != 0;
+      unsigned long long xcr0 = osxsave ? _xgetbv( 0 ) : 0;
+
+      __cpuidex( info, 7, 0 );
+
+      switch( instructionSet_ )
+      {
+        case SSE4:
+          return sse4;
+        case AVX2:
+          return ( xcr0 & 0x6 ) == 0x6 && ( info[ 1 ] & ( 1 << 5 )) != 0;
+        case AVX512:
+          return ( xcr0 & 0xE6 ) == 0xE6 && ( info[ 1 ] & ( 1 << 16 )) != 0;
+        default:
+          return true;
+      }
+#else
+      return instructionSet_ == Scalar;
+#endif
+    }
+
+#else
+
+    static bool _supported( InstructionSet instructionSet_ )
+    {
+      return instructionSet_ == Scalar;
+    }
+
+#endif
+
+    static InstructionSet& _current( void )
+    {
+      static InstructionSet current =
+          _supported( AVX512 ) ? AVX512 :
+          _supported( AVX2 ) ? AVX2 :
+          _supported( SSE4 ) ? SSE4 : Scalar;
+
+      return current;
+    }
+
+    InstructionSet instructionSet( void )
+    {
+      return _current( );
+    }
+
+    bool instructionSet( InstructionSet instructionSet_ )
+    {
+      if( !_supported( instructionSet_ ))
+        return false;
+
+      _current( ) = instructionSet_;
+      return true;
+    }
+
+    bool supported( InstructionSet instructionSet_ )
+    {
+      return _supported( instructionSet_ );
+    }
+
+    const char* name( InstructionSet instructionSet_ )
+    {
+      switch( instructionSet_ )
+      {
+        case SSE4:
+          return "SSE4.1";
+        case AVX2:
+          return "AVX2";
+        case AVX512:
+          return "AVX-512";
+        default:
+          return "Scalar";
+      }
+    }
+
+    void decreaseLife( float* life, unsigned int size, float deltaTime )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _decreaseLifeAVX512( life, size, deltaTime );
+          break;
+        case AVX2:
+          _decreaseLifeAVX2( life, size, deltaTime );
+          break;
+        case SSE4:
+          _decreaseLifeSSE4( life, size, deltaTime );
+          break;
+#endif
+        default:
+          _decreaseLife( life, size, deltaTime );
+      }
+    }
+
+    void integrate( float* const* position, const float* const* velocity,
+                    const float* velocityModule, const char* alive,
+                    unsigned int size, float deltaTime )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _integrateAVX512( position, velocity, velocityModule, alive,
+                            size, deltaTime );
+          break;
+        case AVX2:
+          _integrateAVX2( position, velocity, velocityModule, alive,
+                          size, deltaTime );
+          break;
+        case SSE4:
+          _integrateSSE4( position, velocity, velocityModule, alive,
+                          size, deltaTime );
+          break;
+#endif
+        default:
+          _integrate( position, velocity, velocityModule, alive, 0, size,
+                      deltaTime );
+      }
+    }
+
+    unsigned int expire( float* life, char* alive, unsigned int* killed,
+                         unsigned int size )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          return _expireAVX512( life, alive, killed, size );
+        case AVX2:
+          return _expireAVX2( life, alive, killed, size );
+        case SSE4:
+          return _expireSSE4( life, alive, killed, size );
+#endif
+        default:
+          return _expire( life, alive, killed, 0, size );
+      }
+    }
+
+    void coneDirections( const float* u, const float* v,
+                         float* const* direction, unsigned int size,
+                         float cosAngle )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _coneDirectionsAVX512( u, v, direction, size, cosAngle );
+          break;
+        case AVX2:
+          _coneDirectionsAVX2( u, v, direction, size, cosAngle );
+          break;
+        case SSE4:
+          _coneDirectionsSSE4( u, v, direction, size, cosAngle );
+          break;
+#endif
+        default:
+          _coneDirections( u, v, direction, 0, size, cosAngle );
+      }
+    }
+
+    void cameraDistances( const float* const* position, float* distances,
+                          unsigned int size, const float* camera,
+                          bool squared )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _cameraDistancesAVX512( position, distances, size, camera,
+                                  squared );
+          break;
+        case AVX2:
+          _cameraDistancesAVX2( position, distances, size, camera, squared );
+          break;
+        case SSE4:
+          _cameraDistancesSSE4( position, distances, size, camera, squared );
+          break;
+#endif
+        default:
+          _cameraDistances( position, distances, 0, size, camera, squared );
+      }
+    }
+
+    void cameraDepths( const float* const* position, float* depths,
+                       unsigned int size, const float* camera,
+                       const float* axis )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _cameraDepthsAVX512( position, depths, size, camera, axis );
+          break;
+        case AVX2:
+          _cameraDepthsAVX2( position, depths, size, camera, axis );
+          break;
+        case SSE4:
+          _cameraDepthsSSE4( position, depths, size, camera, axis );
+          break;
+#endif
+        default:
+          _cameraDepths( position, depths, 0, size, camera, axis );
+      }
+    }
+
+    void packInstances( const float* const* values, unsigned char* instances,
+                        unsigned int size )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _packInstancesAVX512( values, instances, size );
+          break;
+        case AVX2:
+          _packInstancesAVX2( values, instances, size );
+          break;
+        case SSE4:
+          _packInstancesSSE4( values, instances, size );
+          break;
+#endif
+        default:
+          _packInstances( values, instances, 0, size );
+      }
+    }
+
+    void halfFloats( const float* values, unsigned short* halves,
+                     unsigned int size )
+    {
+      switch( _current( ))
+      {
+#ifdef PREFR_SIMD_X86
+        case AVX512:
+          _halfFloatsAVX512( values, halves, size );
+          break;
+        case AVX2:
+          _halfFloatsAVX2( values, halves, size );
+          break;
+        case SSE4:
+          _halfFloatsSSE4( values, halves, size );
+          break;
+#endif
+        default:
+          _halfFloats( values, halves, 0, size );
+      }
+    }
+
+  }
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __PREFR_SIMD__
+#define __PREFR_SIMD__
+
+#include <prefr/api.h>
+
+namespace prefr
+{
+  /*! \namespace simd
+   *
+   * \brief Vectorized kernels for the built-in particle update.
+   *
+   * Kernels operate on the attribute arrays of a contiguous range of
+   * particles. The instruction set is detected at runtime (SSE4.1, AVX2 or
+   * AVX-512 on x86 processors) and a scalar implementation is used as
+   * fallback. All implementations perform the same operations, although
+   * results might differ in rounding when the compiler fuses multiplications
+   * and additions.
+   *
+   * @see ParticleSpan
+   * @see Updater::updateRange
+   */
+  namespace simd
+  {
+    /*! Size in bytes of the instances stored by packInstances. */
+    static const unsigned int packedInstanceSize = 12;
+
+    enum InstructionSet
+    {
+      Scalar = 0,
+      SSE4,
+      AVX2,
+      AVX512
+    };
+
+    /*! \brief Returns the instruction set used by the kernels.
+     *
+     * Returns the instruction set used by the kernels. Defaults to the
+     * widest one supported by the running processor.
+     *
+     * @return Instruction set used by the kernels.
+     */
+    PREFR_API InstructionSet instructionSet( void );
+
+    /*! \brief Sets the instruction set used by the kernels.
+     *
+     * Sets the instruction set used by the kernels, mostly for testing and
+     * benchmarking purposes. Instruction sets not supported by the running
+     * processor are ignored. Not thread safe: call it while no kernels are
+     * being run.
+     *
+     * @param instructionSet Instruction set to be used.
+     * @return true if the instruction set is supported, false if not.
+     */
+    PREFR_API bool instructionSet( InstructionSet instructionSet );
+
+    /*! \brief Returns true if the running processor supports the given
+     * instruction set.
+     *
+     * @param instructionSet Instruction set to be checked.
+     * @return true if supported, false if not.
+     */
+    PREFR_API bool supported( InstructionSet instructionSet );
+
+    /*! \brief Returns the name of the given instruction set.
+     */
+    PREFR_API const char* name( InstructionSet instructionSet );
+
+    /*! \brief Decreases life values by the given delta time.
+     *
+     * @param life Life values.
+     * @param size Number of values.
+     * @param deltaTime Value to be subtracted.
+     */
+    PREFR_API void decreaseLife( float* life, unsigned int size,
+                                 float deltaTime );
+
+    /*! \brief Moves alive particles along their velocity.
+     *
+     * Computes position += velocity * velocityModule * deltaTime for every
+     * alive particle. Positions and velocities are given as their x, y and z
+     * component arrays.
+     *
+     * @param position Position component arrays, size values each.
+     * @param velocity Velocity direction component arrays, size values each.
+     * @param velocityModule Velocity modules, size values.
+     * @param alive Alive flags, size values.
+     * @param size Number of particles.
+     * @param deltaTime Integration step.
+     */
+    PREFR_API void integrate( float* const* position,
+                              const float* const* velocity,
+                              const float* velocityModule, const char* alive,
+                              unsigned int size, float deltaTime );
+
+    /*! \brief Kills alive particles whose life reached zero.
+     *
+     * Sets life to zero and clears the alive flag of alive particles with
+     * life lower or equal than zero. Positions of killed particles are
+     * stored in ascending order into killed, which must have room for size
+     * values.
+     *
+     * @param life Life values.
+     * @param alive Alive flags.
+     * @param killed Output positions of killed particles.
+     * @param size Number of particles.
+     * @return Number of killed particles.
+     */
+    PREFR_API unsigned int expire( float* life, char* alive,
+                                   unsigned int* killed, unsigned int size );
+
+    /*! \brief Maps pairs of uniform random values to directions uniformly
+     * distributed within a cone around the +Y axis.
+     *
+     * Computes y = 1 - u * ( 1 - cosAngle ) and rotates the remaining
+     * radius around the axis by a full turn times v. Sine and cosine are
+     * evaluated with polynomials, so no libm call is made. A cosAngle of
+     * -1 covers the whole sphere. u and v may be stored in any of the
+     * direction arrays, as values are read before writing each direction.
+     *
+     * @param u Random values in [0, 1) selecting the angle to the axis.
+     * @param v Random values in [0, 1) selecting the angle around the axis.
+     * @param direction Output direction component arrays, size values each.
+     * @param size Number of directions.
+     * @param cosAngle Cosine of the cone half aperture.
+     */
+    PREFR_API void coneDirections( const float* u, const float* v,
+                                   float* const* direction, unsigned int size,
+                                   float cosAngle );
+
+    /*! \brief Computes the distances from positions to the camera.
+     *
+     * @param position Position component arrays, size values each.
+     * @param distances Output distances, size values.
+     * @param size Number of particles.
+     * @param camera Camera position, 3 values.
+     * @param squared true to store squared distances, saving the square
+     * root while keeping the same order.
+     */
+    PREFR_API void cameraDistances( const float* const* position,
+                                    float* distances, unsigned int size,
+                                    const float* camera, bool squared );
+
+    /*! \brief Computes the depths of positions along the view axis.
+     *
+     * Stores dot( position - camera, axis ) for each position.
+     *
+     * @param position Position component arrays, size values each.
+     * @param depths Output depths, size values.
+     * @param size Number of particles.
+     * @param camera Camera position, 3 values.
+     * @param axis Unit view direction, 3 values.
+     */
+    PREFR_API void cameraDepths( const float* const* position, float* depths,
+                                 unsigned int size, const float* camera,
+                                 const float* axis );
+
+    /*! \brief Packs particle render attributes into compact instances.
+     *
+     * Each instance takes packedInstanceSize bytes: position and size as
+     * four half floats, rounded to nearest even, followed by the color as
+     * four 8-bit normalized values, clamped to [0, 1]. Instances are stored
+     * contiguously, with no alignment requirements.
+     *
+     * @param values x, y, z, size, red, green, blue and alpha arrays, size
+     * values each.
+     * @param instances Output instances, size * packedInstanceSize bytes.
+     * @param size Number of instances.
+     */
+    PREFR_API void packInstances( const float* const* values,
+                                  unsigned char* instances,
+                                  unsigned int size );
+
+    /*! \brief Converts floats to half floats, rounding to nearest even.
+     *
+     * Uses the same conversion as packInstances.
+     *
+     * @param values Values to be converted.
+     * @param halves Output half float bits, size values.
+     * @param size Number of values.
+     */
+    PREFR_API void halfFloats( const float* values, unsigned short* halves,
+                               unsigned int size );
+  }
+}
+
+#endif /* __PREFR_SIMD__ */
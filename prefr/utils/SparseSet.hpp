@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __UTILS_SPARSESET__
+#define __UTILS_SPARSESET__
+
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+namespace prefr
+{
+
+  /*! \class SparseSet
+   *
+   * \brief Set of unsigned indices stored as a dense array plus a sparse
+   * position map.
+   *
+   * Elements are kept contiguous in a dense array that can be iterated
+   * directly, while the sparse array maps each element to its position
+   * within the dense one. This allows constant time insertion, removal and
+   * membership queries. Removal moves the last element into the freed
+   * position, so iteration order is not preserved.
+   *
+   * The sparse array only covers the interval between the lowest and the
+   * highest inserted values, keeping the memory footprint proportional to
+   * that interval instead of to the highest index.
+   *
+   */
+  template< typename T = unsigned int >
+  class SparseSet
+  {
+    static_assert( std::is_integral< T >::value &&
+                   std::is_unsigned< T >::value,
+                   "SparseSet requires unsigned integral elements." );
+
+  public:
+
+    typedef typename std::vector< T >::const_iterator const_iterator;
+
+    static const T npos = std::numeric_limits< T >::max( );
+
+    SparseSet( void )
+    : _offset( 0 )
+    { }
+
+    SparseSet( const std::vector< T >& elements )
+    : _offset( 0 )
+    {
+      insert( elements );
+    }
+
+    SparseSet( const std::set< T >& elements )
+    : _offset( 0 )
+    {
+      insert( elements );
+    }
+
+    SparseSet( const_iterator begin_, const_iterator end_ )
+    : _offset( 0 )
+    {
+      for( const_iterator it = begin_; it != end_; ++it )
+        append( *it );
+    }
+
+    SparseSet( std::initializer_list< T > initializer )
+    : _offset( 0 )
+    {
+      for( auto element : initializer )
+        append( element );
+    }
+
+    size_t size( void ) const
+    {
+      return _elements.size( );
+    }
+
+    bool empty( void ) const
+    {
+      return _elements.empty( );
+    }
+
+    void clear( void )
+    {
+      _elements.clear( );
+      _positions.clear( );
+      _offset = 0;
+    }
+
+    void reserve( size_t size_ )
+    {
+      _elements.reserve( size_ );
+    }
+
+    std::set< T > set( void ) const
+    {
+      return std::set< T >( _elements.begin( ), _elements.end( ));
+    }
+
+    const std::vector< T >& vector( void ) const
+    {
+      return _elements;
+    }
+
+    /*! \brief Returns the position of the given element within the dense
+     * array or SparseSet::npos if not contained.
+     */
+    T position( const T& value ) const
+    {
+      if( value < _offset || value - _offset >= _positions.size( ))
+        return npos;
+
+      return _positions[ value - _offset ];
+    }
+
+    const_iterator find( const T& value ) const
+    {
+      T pos = position( value );
+      return pos == npos ? end( ) : begin( ) + pos;
+    }
+
+    bool hasElement( const T& value ) const
+    {
+      return position( value ) != npos;
+    }
+
+    const_iterator begin( void ) const
+    {
+      return _elements.begin( );
+    }
+
+    const_iterator end( void ) const
+    {
+      return _elements.end( );
+    }
+
+    const T& operator[]( size_t i ) const
+    {
+      return _elements[ i ];
+    }
+
+    bool push_back( const T& element )
+    {
+      if( hasElement( element ))
+        return false;
+
+      _cover( element );
+
+      _positions[ element - _offset ] = T( _elements.size( ));
+      _elements.push_back( element );
+
+      return true;
+    }
+
+    bool append( const T& element ){ return push_back( element ); }
+
+    void insert( const SparseSet& other )
+    {
+      _elements.reserve( _elements.size( ) + other.size( ));
+      for( auto element : other )
+        append( element );
+    }
+
+    void insert( const std::vector< T >& others )
+    {
+      _elements.reserve( _elements.size( ) + others.size( ));
+      for( auto element : others )
+        append( element );
+    }
+
+    void insert( const std::set< T >& others )
+    {
+      for( auto element : others )
+        append( element );
+    }
+
+    bool remove( const T& element )
+    {
+      T pos = position( element );
+      if( pos == npos )
+        return false;
+
+      T last = _elements.back( );
+      _elements[ pos ] = last;
+      _positions[ last - _offset ] = pos;
+
+      _elements.pop_back( );
+      _positions[ element - _offset ] = npos;
+
+      if( _elements.empty( ))
+        clear( );
+
+      return true;
+    }
+
+    void remove( const SparseSet& other )
+    {
+      for( auto element : other )
+        remove( element );
+    }
+
+    void remove( const std::vector< T >& others )
+    {
+      for( auto element : others )
+        remove( element );
+    }
+
+    void remove( const std::set< T >& others )
+    {
+      for( auto element : others )
+        remove( element );
+    }
+
+    /*! \brief Removes the elements satisfying the given predicate, keeping
+     * the order of the remaining ones.
+     */
+    template< typename Predicate >
+    void removeIf( Predicate predicate )
+    {
+      size_t size_ = 0;
+      for( size_t i = 0; i < _elements.size( ); ++i )
+      {
+        T element = _elements[ i ];
+        if( predicate( element ))
+        {
+          _positions[ element - _offset ] = npos;
+          continue;
+        }
+
+        _positions[ element - _offset ] = T( size_ );
+        _elements[ size_++ ] = element;
+      }
+
+      _elements.resize( size_ );
+
+      if( _elements.empty( ))
+        clear( );
+    }
+
+    /*! \brief Sorts the dense array in ascending order.
+     *
+     * Elements appended after a sorted prefix are sorted and merged into
+     * it, so keeping the set mostly sorted makes this linear.
+     */
+    void sort( void )
+    {
+      auto middle = std::is_sorted_until( _elements.begin( ),
+                                          _elements.end( ));
+      if( middle == _elements.end( ))
+        return;
+
+      std::sort( middle, _elements.end( ));
+      std::inplace_merge( _elements.begin( ), middle, _elements.end( ));
+
+      for( size_t i = 0; i < _elements.size( ); ++i )
+        _positions[ _elements[ i ] - _offset ] = T( i );
+    }
+
+  protected:
+
+    // Grows the sparse array, if needed, to cover the given value. Growing
+    // below the current offset reserves as much slack as the covered span
+    // to keep descending insertions amortized.
+    void _cover( const T& value )
+    {
+      if( _positions.empty( ))
+      {
+        _offset = value;
+        _positions.assign( 1, npos );
+      }
+      else if( value < _offset )
+      {
+        size_t slack = std::min< size_t >( _positions.size( ),
+                                           value );
+        T newOffset = T( value - slack );
+
+        std::vector< T > positions( _offset - newOffset + _positions.size( ),
+                                    npos );
+        std::copy( _positions.begin( ), _positions.end( ),
+                   positions.begin( ) + ( _offset - newOffset ));
+
+        _positions.swap( positions );
+        _offset = newOffset;
+      }
+      else if( value - _offset >= _positions.size( ))
+      {
+        _positions.resize( value - _offset + 1, npos );
+      }
+    }
+
+    std::vector< T > _elements;
+    std::vector< T > _positions;
+    T _offset;
+  };
+
+  template< typename T >
+  const T SparseSet< T >::npos;
+
+}
+
+#endif /* __UTILS_SPARSESET__ */
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2014-2020 GMRV/URJC.
+ *
+ * Authors: Sergio E. Galindo <sergio.galindo@urjc.es>
+ *
+ * This file is part of PReFr <https://github.com/gmrvvis/prefr>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef __UTILS_SPLITVECTOR__
+#define __UTILS_SPLITVECTOR__
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace prefr
+{
+
+  /*! \class SplitReference
+   *
+   * \brief Reference to a vector value whose components are stored in
+   * separate arrays.
+   *
+   * Converts to the vector type when read and scatters the components when
+   * assigned, so it can be used as a T&.
+   */
+  template< typename T,
+            unsigned int N = sizeof( T ) / sizeof( typename T::value_type ) >
+  class SplitReference
+  {
+  public:
+
+    typedef typename T::value_type value_type;
+
+    explicit SplitReference( value_type* const* components )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ] = components[ c ];
+    }
+
+    operator T( void ) const
+    {
+      T result;
+      for( unsigned int c = 0; c < N; ++c )
+        result[ c ] = *_components[ c ];
+
+      return result;
+    }
+
+    SplitReference& operator=( const T& value )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        *_components[ c ] = value[ c ];
+
+      return *this;
+    }
+
+    SplitReference& operator=( const SplitReference& other )
+    {
+      return *this = T( other );
+    }
+
+    value_type& operator[]( unsigned int component ) const
+    {
+      return *_components[ component ];
+    }
+
+  protected:
+
+    value_type* _components[ N ];
+  };
+
+  /*! \class SplitPointer
+   *
+   * \brief Pointer to a vector value whose components are stored in
+   * separate arrays.
+   *
+   * Keeps one pointer per component and moves all of them together, so it
+   * supports the same arithmetic than a T*.
+   */
+  template< typename T,
+            unsigned int N = sizeof( T ) / sizeof( typename T::value_type ) >
+  class SplitPointer
+  {
+  public:
+
+    typedef typename T::value_type value_type;
+    typedef SplitReference< T, N > reference;
+
+    SplitPointer( std::nullptr_t = nullptr )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ] = nullptr;
+    }
+
+    explicit SplitPointer( value_type* const* components )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ] = components[ c ];
+    }
+
+    value_type* component( unsigned int c ) const
+    {
+      return _components[ c ];
+    }
+
+    reference operator*( void ) const
+    {
+      return reference( _components );
+    }
+
+    reference operator[]( ptrdiff_t i ) const
+    {
+      return *( *this + i );
+    }
+
+    SplitPointer& operator+=( ptrdiff_t inc )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ] += inc;
+
+      return *this;
+    }
+
+    SplitPointer& operator-=( ptrdiff_t dec )
+    {
+      return *this += -dec;
+    }
+
+    SplitPointer operator+( ptrdiff_t inc ) const
+    {
+      SplitPointer result( *this );
+      return result += inc;
+    }
+
+    SplitPointer operator-( ptrdiff_t dec ) const
+    {
+      SplitPointer result( *this );
+      return result -= dec;
+    }
+
+    bool operator==( const SplitPointer& other ) const
+    {
+      return _components[ 0 ] == other._components[ 0 ];
+    }
+
+    bool operator!=( const SplitPointer& other ) const
+    {
+      return !( *this == other );
+    }
+
+  protected:
+
+    value_type* _components[ N ];
+  };
+
+  /*! \class SplitVector
+   *
+   * \brief Array of vector values stored as one array per component.
+   *
+   * Stores x, y, z... components in separate arrays, allocated through
+   * Allocator, so each component can be processed with plain vector loads.
+   * Values are accessed through SplitReference and SplitPointer objects.
+   */
+  template< typename T,
+            typename Allocator = std::allocator< typename T::value_type >,
+            unsigned int N = sizeof( T ) / sizeof( typename T::value_type ) >
+  class SplitVector
+  {
+  public:
+
+    typedef typename T::value_type value_type;
+    typedef SplitReference< T, N > reference;
+    typedef SplitPointer< T, N > pointer;
+
+    static const unsigned int components = N;
+
+    size_t size( void ) const
+    {
+      return _components[ 0 ].size( );
+    }
+
+    bool empty( void ) const
+    {
+      return _components[ 0 ].empty( );
+    }
+
+    void resize( size_t size_ )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ].resize( size_, value_type( ));
+    }
+
+    void resize( size_t size_, const T& value )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ].resize( size_, value[ c ]);
+    }
+
+    void clear( void )
+    {
+      for( unsigned int c = 0; c < N; ++c )
+        _components[ c ].clear( );
+    }
+
+    value_type* component( unsigned int c )
+    {
+      return _components[ c ].data( );
+    }
+
+    const value_type* component( unsigned int c ) const
+    {
+      return _components[ c ].data( );
+    }
+
+    pointer data( void )
+    {
+      value_type* components_[ N ];
+      for( unsigned int c = 0; c < N; ++c )
+        components_[ c ] = _components[ c ].data( );
+
+      return pointer( components_ );
+    }
+
+    pointer data( void ) const
+    {
+      return const_cast< SplitVector* >( this )->data( );
+    }
+
+    reference operator[]( size_t i )
+    {
+      return data( )[ i ];
+    }
+
+    T operator[]( size_t i ) const
+    {
+      T result;
+      for( unsigned int c = 0; c < N; ++c )
+        result[ c ] = _components[ c ][ i ];
+
+      return result;
+    }
+
+  protected:
+
+    std::vector< value_type, Allocator > _components[ N ];
+  };
+
+  template< typename T, typename Allocator, unsigned int N >
+  const unsigned int SplitVector< T, Allocator, N >::components;
+
+}
+
+#endif /* __UTILS_SPLITVECTOR__ */